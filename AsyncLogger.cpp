@@ -0,0 +1,161 @@
+#include "AsyncLogger.h"
+#include <algorithm>
+
+AsyncLogger::AsyncLogger()
+{
+    _drainMutex = xSemaphoreCreateMutex();
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    vSemaphoreDelete(_drainMutex);
+    _drainMutex = nullptr;
+}
+
+size_t AsyncLogger::write(uint8_t character)
+{
+    return write(&character, 1);
+}
+
+size_t AsyncLogger::write(const uint8_t* buffer, size_t size)
+{
+    portENTER_CRITICAL(&_mux);
+    if(size > ASYNC_LOGGER_BUFFER_SIZE - (_writeIndex - _readIndex))
+    {
+        // Dropping the whole write keeps the lines that make it into the buffer intact
+        _droppedBytes += size;
+    }
+    else
+    {
+        const size_t offset = _writeIndex & (ASYNC_LOGGER_BUFFER_SIZE - 1);
+        const size_t first = std::min(size, ASYNC_LOGGER_BUFFER_SIZE - offset);
+        memcpy(_buffer + offset, buffer, first);
+        memcpy(_buffer, buffer + first, size - first);
+        _writeIndex += size;
+    }
+    portEXIT_CRITICAL(&_mux);
+
+    // Report success either way, Print would otherwise stop at the first dropped write
+    return size;
+}
+
+void AsyncLogger::flush()
+{
+    xSemaphoreTake(_drainMutex, portMAX_DELAY);
+    size_t length;
+    while((length = takeBatch(true)) > 0)
+    {
+        output(length);
+    }
+    Serial.flush();
+    xSemaphoreGive(_drainMutex);
+}
+
+void AsyncLogger::setMqttClient(MqttClient* client, const char* topic)
+{
+    _mqttClient = client;
+    _topic = topic;
+}
+
+void AsyncLogger::drain()
+{
+    xSemaphoreTake(_drainMutex, portMAX_DELAY);
+
+    size_t length;
+    while((length = takeBatch(false)) > 0)
+    {
+        output(length);
+    }
+
+    uint32_t droppedBytes = this->droppedBytes();
+    if(droppedBytes != _reportedDroppedBytes)
+    {
+        // Goes through the buffer like any other line, so it reaches MQTT as well
+        print(F("Log buffer full, dropped bytes: "));
+        println(droppedBytes - _reportedDroppedBytes);
+        _reportedDroppedBytes = droppedBytes;
+    }
+
+    xSemaphoreGive(_drainMutex);
+}
+
+const uint32_t AsyncLogger::droppedBytes() const
+{
+    return _droppedBytes;
+}
+
+size_t AsyncLogger::takeBatch(const bool& force)
+{
+    portENTER_CRITICAL(&_mux);
+    const uint32_t readIndex = _readIndex;
+    const uint32_t available = _writeIndex - readIndex;
+    portEXIT_CRITICAL(&_mux);
+
+    if(available == 0)
+    {
+        _partialLineTs = 0;
+        return 0;
+    }
+
+    // The bytes between the read and the write index are only changed after the read index moved on
+    const size_t limit = std::min(available, (uint32_t)ASYNC_LOGGER_BATCH_SIZE);
+    size_t length = 0;
+    for(size_t i = limit; i > 0; i--)
+    {
+        if(_buffer[(readIndex + i - 1) & (ASYNC_LOGGER_BUFFER_SIZE - 1)] == '\n')
+        {
+            length = i;
+            break;
+        }
+    }
+
+    if(length == 0)
+    {
+        // Wait for the rest of the line, unless it doesn't fit into a batch or the writer never finishes it
+        if(_partialLineTs == 0)
+        {
+            _partialLineTs = millis();
+        }
+        if(!force && limit < ASYNC_LOGGER_BATCH_SIZE && millis() - _partialLineTs < ASYNC_LOGGER_PARTIAL_LINE_TIMEOUT)
+        {
+            return 0;
+        }
+        length = limit;
+    }
+    _partialLineTs = 0;
+
+    const size_t offset = readIndex & (ASYNC_LOGGER_BUFFER_SIZE - 1);
+    const size_t first = std::min(length, ASYNC_LOGGER_BUFFER_SIZE - offset);
+    memcpy(_batch, _buffer + offset, first);
+    memcpy(_batch + first, _buffer, length - first);
+
+    portENTER_CRITICAL(&_mux);
+    _readIndex += length;
+    portEXIT_CRITICAL(&_mux);
+
+    return length;
+}
+
+void AsyncLogger::output(const size_t& length)
+{
+    Serial.write((const uint8_t*)_batch, length);
+
+    if(_mqttClient == nullptr || !_mqttClient->connected())
+    {
+        return;
+    }
+
+    size_t payloadLength = length;
+    if(_batch[payloadLength - 1] == '\n')
+    {
+        --payloadLength;
+    }
+    if(payloadLength > 0 && _batch[payloadLength - 1] == '\r')
+    {
+        --payloadLength;
+    }
+    if(payloadLength > 0)
+    {
+        _mqttClient->publish(_topic, 0, true, (const uint8_t*)_batch, payloadLength);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Print.h>
+#include <espMqttClient.h>
+
+#define ASYNC_LOGGER_BUFFER_SIZE 4096 // power of two
+#define ASYNC_LOGGER_BATCH_SIZE 1024
+#define ASYNC_LOGGER_DRAIN_INTERVAL 50
+#define ASYNC_LOGGER_PARTIAL_LINE_TIMEOUT 1000
+
+// Print implementation that only copies into a ring buffer, so that logging never waits for Serial or MQTT.
+// A low priority task calls drain(), which batches complete lines into one Serial write and one MQTT message.
+// Writers hold a spinlock only for the copy; a lock-free reservation would make a task spin on a preempted
+// lower priority writer on the same core.
+class AsyncLogger : public Print
+{
+public:
+    AsyncLogger();
+    virtual ~AsyncLogger();
+
+    size_t write(uint8_t character) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // Writes everything buffered from the calling task, e.g. before a restart
+    void flush() override;
+
+    void setMqttClient(MqttClient* client, const char* topic);
+
+    // Log task side
+    void drain();
+
+    const uint32_t droppedBytes() const;
+
+private:
+    size_t takeBatch(const bool& force);
+    void output(const size_t& length);
+
+    char _buffer[ASYNC_LOGGER_BUFFER_SIZE];
+    uint32_t _writeIndex = 0;
+    uint32_t _readIndex = 0;
+    uint32_t _droppedBytes = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+    // Used only while holding _drainMutex
+    SemaphoreHandle_t _drainMutex = nullptr;
+    char _batch[ASYNC_LOGGER_BATCH_SIZE];
+    uint32_t _reportedDroppedBytes = 0;
+    unsigned long _partialLineTs = 0;
+
+    MqttClient* _mqttClient = nullptr;
+    const char* _topic = nullptr;
+};
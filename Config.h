@@ -8,5 +8,16 @@
 
 #define MQTT_QOS_LEVEL 1
 #define MQTT_CLEAN_SESSIONS false
+#define MQTT_CONNECT_TIMEOUT 60000
+#define MQTT_RECONNECT_BACKOFF_MIN 5000
+#define MQTT_RECONNECT_BACKOFF_MAX 120000
+#define MQTT_SESSION_EXPIRY_INTERVAL 86400 // seconds, MQTT 5 only
+#define MQTT_PRESENCE_EVENTS_EXPIRY 300 // seconds, MQTT 5 only
+#define MQTT_MAX_INCOMING_PAYLOAD 255 // larger messages are ignored
 
 #define GPIO_DEBOUNCE_TIME 200
+#define GPIO_GENERAL_INPUT_DEBOUNCE_TIME 300
+
+#define BLE_SCAN_LOW_DUTY_INTERVAL 160
+#define BLE_SCAN_LOW_DUTY_WINDOW 40
+#define BLE_SCAN_COMMAND_HIGH_DUTY_TIME 10000
@@ -0,0 +1,303 @@
+#include "EventLog.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstddef>
+
+#define EVENT_LOG_SLOTS_PER_SECTOR (EVENT_LOG_SECTOR_SIZE / sizeof(EventLogRecord))
+
+EventLog* eventLog = nullptr;
+
+EventLog::EventLog()
+{
+    _queue = xQueueCreate(EVENT_LOG_QUEUE_LENGTH, sizeof(EventLogRecord));
+    _flashMutex = xSemaphoreCreateMutex();
+}
+
+EventLog::~EventLog()
+{
+    vQueueDelete(_queue);
+    _queue = nullptr;
+    vSemaphoreDelete(_flashMutex);
+    _flashMutex = nullptr;
+}
+
+void EventLog::initialize()
+{
+    size_t size = 0;
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)EVENT_LOG_PARTITION_SUBTYPE, EVENT_LOG_PARTITION_LABEL);
+    if(_partition != nullptr)
+    {
+        size = _partition->size;
+    }
+    else
+    {
+        // Devices flashed with an older partition table have an unused spiffs partition instead
+        _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+        if(_partition != nullptr)
+        {
+            size = std::min(_partition->size, (uint32_t)EVENT_LOG_FALLBACK_SIZE);
+        }
+    }
+
+    size -= size % EVENT_LOG_SECTOR_SIZE;
+    if(_partition == nullptr || size < 2 * EVENT_LOG_SECTOR_SIZE)
+    {
+        Log->println(F("No partition for the event log found, event log disabled."));
+        _partition = nullptr;
+        return;
+    }
+    _slotCount = size / sizeof(EventLogRecord);
+
+    // The sector whose first record has the highest sequence number holds the write position,
+    // the one with the lowest sequence number the oldest records
+    const uint32_t sectorCount = _slotCount / EVENT_LOG_SLOTS_PER_SECTOR;
+    EventLogRecord record;
+    int headSector = -1;
+    int oldestSector = -1;
+    uint32_t maxSequence = 0;
+    uint32_t minSequence = 0xFFFFFFFF;
+    for(uint32_t sector = 0; sector < sectorCount; sector++)
+    {
+        if(!readSlot(sector * EVENT_LOG_SLOTS_PER_SECTOR, record))
+        {
+            continue;
+        }
+        if(record.sequence >= maxSequence)
+        {
+            maxSequence = record.sequence;
+            headSector = sector;
+        }
+        if(record.sequence < minSequence)
+        {
+            minSequence = record.sequence;
+            oldestSector = sector;
+        }
+    }
+
+    if(headSector < 0)
+    {
+        _headSlot = 0;
+        _oldestSlot = 0;
+        if(!isSectorBlank(0))
+        {
+            prepareSector(0);
+        }
+    }
+    else
+    {
+        _headSlot = headSector * EVENT_LOG_SLOTS_PER_SECTOR;
+        _oldestSlot = oldestSector * EVENT_LOG_SLOTS_PER_SECTOR;
+        const uint32_t sectorEnd = _headSlot + EVENT_LOG_SLOTS_PER_SECTOR;
+        while(_headSlot < sectorEnd && readSlot(_headSlot, record))
+        {
+            _nextSequence = record.sequence + 1;
+            _boot = record.boot;
+            ++_headSlot;
+        }
+
+        if(_headSlot == sectorEnd)
+        {
+            // Restarted after filling the sector. The next sector is normally erased already, unless the restart
+            // happened between writing the last record and erasing it.
+            _headSlot = sectorEnd % _slotCount;
+            if(!isSectorBlank(_headSlot))
+            {
+                prepareSector(_headSlot);
+            }
+        }
+    }
+    ++_boot;
+
+    Log->print(F("Event log: "));
+    Log->print(recordCount());
+    Log->print(F(" records, boot "));
+    Log->println(_boot);
+}
+
+void EventLog::record(const EventId& event, const uint32_t& arg)
+{
+    if(_partition == nullptr) return;
+
+    EventLogRecord record;
+    record.uptime = millis();
+    record.boot = _boot;
+    record.event = event;
+    record.arg = arg;
+
+    // Never wait, dropping an event is better than stalling the nuki or network task
+    xQueueSend(_queue, &record, 0);
+}
+
+void EventLog::update()
+{
+    if(_partition == nullptr) return;
+
+    uint32_t heapLowWater = esp_get_minimum_free_heap_size();
+    if(_heapLowWater == 0 || heapLowWater + EVENT_LOG_HEAP_STEP <= _heapLowWater)
+    {
+        _heapLowWater = heapLowWater;
+        record(EventId::HeapLowWater, heapLowWater);
+    }
+
+    flush();
+}
+
+void EventLog::flush()
+{
+    if(_partition == nullptr) return;
+
+    xSemaphoreTake(_flashMutex, portMAX_DELAY);
+    EventLogRecord record;
+    while(xQueueReceive(_queue, &record, 0) == pdTRUE)
+    {
+        writeRecord(record);
+    }
+    xSemaphoreGive(_flashMutex);
+}
+
+size_t EventLog::read(uint32_t& cursor, EventLogRecord* records, const size_t& maxCount)
+{
+    if(_partition == nullptr) return 0;
+
+    size_t count = 0;
+    xSemaphoreTake(_flashMutex, portMAX_DELAY);
+    const uint32_t available = (_headSlot + _slotCount - _oldestSlot) % _slotCount;
+    while(count < maxCount && cursor < available)
+    {
+        if(readSlot((_oldestSlot + cursor) % _slotCount, records[count]))
+        {
+            ++count;
+        }
+        ++cursor;
+    }
+    xSemaphoreGive(_flashMutex);
+    return count;
+}
+
+const uint32_t EventLog::recordCount()
+{
+    if(_partition == nullptr) return 0;
+
+    xSemaphoreTake(_flashMutex, portMAX_DELAY);
+    const uint32_t count = (_headSlot + _slotCount - _oldestSlot) % _slotCount;
+    xSemaphoreGive(_flashMutex);
+    return count;
+}
+
+size_t EventLog::format(const EventLogRecord& record, char* str, const size_t& size)
+{
+    int length = snprintf(str, size, "%lu;%u;%lu;%s;%lu\n", (unsigned long)record.sequence, (unsigned)record.boot,
+                          (unsigned long)record.uptime, eventName(record.event), (unsigned long)record.arg);
+    return length < 0 ? 0 : std::min((size_t)length, size - 1);
+}
+
+const char* EventLog::eventName(const EventId& event)
+{
+    switch(event)
+    {
+        case EventId::Boot:
+            return "boot";
+        case EventId::Restart:
+            return "restart";
+        case EventId::MqttConnected:
+            return "mqttConnected";
+        case EventId::MqttConnectFailed:
+            return "mqttConnectFailed";
+        case EventId::MqttDisconnected:
+            return "mqttDisconnected";
+        case EventId::LockCommandResult:
+            return "lockCommandResult";
+        case EventId::LockCommandRetry:
+            return "lockCommandRetry";
+        case EventId::OpenerCommandResult:
+            return "openerCommandResult";
+        case EventId::OpenerCommandRetry:
+            return "openerCommandRetry";
+        case EventId::HeapLowWater:
+            return "heapLowWater";
+        default:
+            return "unknown";
+    }
+}
+
+const bool EventLog::enabled() const
+{
+    return _partition != nullptr;
+}
+
+void EventLog::writeRecord(EventLogRecord& record)
+{
+    record.sequence = _nextSequence++;
+    record.checksum = checksum(record);
+
+    if(esp_partition_write(_partition, _headSlot * sizeof(EventLogRecord), &record, sizeof(EventLogRecord)) != ESP_OK)
+    {
+        return;
+    }
+
+    _headSlot = (_headSlot + 1) % _slotCount;
+    if(_headSlot % EVENT_LOG_SLOTS_PER_SECTOR == 0)
+    {
+        prepareSector(_headSlot);
+    }
+}
+
+void EventLog::prepareSector(const uint32_t& slot)
+{
+    esp_partition_erase_range(_partition, slot * sizeof(EventLogRecord), EVENT_LOG_SECTOR_SIZE);
+
+    // The oldest records were in the sector that was just erased
+    if(_oldestSlot / EVENT_LOG_SLOTS_PER_SECTOR == slot / EVENT_LOG_SLOTS_PER_SECTOR)
+    {
+        _oldestSlot = (slot + EVENT_LOG_SLOTS_PER_SECTOR) % _slotCount;
+    }
+}
+
+bool EventLog::isSectorBlank(const uint32_t& slot)
+{
+    uint32_t words[sizeof(EventLogRecord) / sizeof(uint32_t)];
+    for(uint32_t offset = 0; offset < EVENT_LOG_SECTOR_SIZE; offset += sizeof(words))
+    {
+        if(esp_partition_read(_partition, slot * sizeof(EventLogRecord) + offset, words, sizeof(words)) != ESP_OK)
+        {
+            return false;
+        }
+        for(const auto& word : words)
+        {
+            if(word != 0xFFFFFFFF)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool EventLog::readSlot(const uint32_t& slot, EventLogRecord& record)
+{
+    if(esp_partition_read(_partition, slot * sizeof(EventLogRecord), &record, sizeof(EventLogRecord)) != ESP_OK)
+    {
+        return false;
+    }
+    return isValid(record);
+}
+
+uint8_t EventLog::checksum(const EventLogRecord& record)
+{
+    const uint8_t* bytes = (const uint8_t*)&record;
+    uint8_t sum = 0;
+    for(size_t i = 0; i < sizeof(EventLogRecord); i++)
+    {
+        if(i != offsetof(EventLogRecord, checksum))
+        {
+            sum += bytes[i];
+        }
+    }
+    return ~sum;
+}
+
+bool EventLog::isValid(const EventLogRecord& record)
+{
+    // Also rejects records torn by a power loss while writing
+    return record.sequence != 0xFFFFFFFF && record.checksum == checksum(record);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+#define EVENT_LOG_PARTITION_LABEL "eventlog"
+#define EVENT_LOG_PARTITION_SUBTYPE 0x99
+#define EVENT_LOG_FALLBACK_SIZE 0x10000
+#define EVENT_LOG_SECTOR_SIZE 4096
+#define EVENT_LOG_QUEUE_LENGTH 16
+#define EVENT_LOG_HEAP_STEP 1024
+#define EVENT_LOG_TEXT_LENGTH 64
+
+enum class EventId : uint8_t
+{
+    Boot = 1,               // arg: firmware restart reason | ESP reset reason << 16
+    Restart,                // arg: RestartReason
+    MqttConnected,
+    MqttConnectFailed,
+    MqttDisconnected,       // arg: espMqttClientTypes::DisconnectReason
+    LockCommandResult,      // arg: CmdResult | LockAction << 8
+    LockCommandRetry,       // arg: retry number, 0 if the command was aborted
+    OpenerCommandResult,    // arg: CmdResult | LockAction << 8
+    OpenerCommandRetry,     // arg: retry number, 0 if the command was aborted
+    HeapLowWater            // arg: minimum free heap in bytes
+};
+
+struct EventLogRecord
+{
+    uint32_t sequence; // 0xFFFFFFFF if the slot is erased
+    uint32_t uptime; // ms
+    uint16_t boot;
+    EventId event;
+    uint8_t checksum;
+    uint32_t arg;
+};
+
+static_assert(sizeof(EventLogRecord) == 16, "Event log records have to divide the flash sector size");
+
+// Fixed size event records in a flash partition used as a ring of sectors. The sector ahead of the write
+// position is erased when the current one is full, so every sector is erased once per pass over the ring.
+// record() only queues the record and can be called from any task, update() writes it to flash.
+class EventLog
+{
+public:
+    EventLog();
+    virtual ~EventLog();
+
+    void initialize();
+
+    void record(const EventId& event, const uint32_t& arg = 0);
+
+    // Writes queued records and tracks the heap low water mark, called by the log task
+    void update();
+    // Writes queued records from the calling task, e.g. before a restart
+    void flush();
+
+    // Reads up to maxCount records, oldest first. cursor starts at 0, or at recordCount() - n for the latest n records.
+    size_t read(uint32_t& cursor, EventLogRecord* records, const size_t& maxCount);
+    const uint32_t recordCount();
+
+    static size_t format(const EventLogRecord& record, char* str, const size_t& size); // "sequence;boot;uptime;event;arg"
+    static const char* eventName(const EventId& event);
+
+    const bool enabled() const;
+
+private:
+    void writeRecord(EventLogRecord& record);
+    void prepareSector(const uint32_t& slot);
+    bool isSectorBlank(const uint32_t& slot);
+    bool readSlot(const uint32_t& slot, EventLogRecord& record);
+    static uint8_t checksum(const EventLogRecord& record);
+    static bool isValid(const EventLogRecord& record);
+
+    const esp_partition_t* _partition = nullptr;
+    uint32_t _slotCount = 0;
+    QueueHandle_t _queue = nullptr;
+    uint32_t _heapLowWater = 0;
+
+    // Used only while holding _flashMutex
+    SemaphoreHandle_t _flashMutex = nullptr;
+    uint32_t _headSlot = 0;
+    uint32_t _oldestSlot = 0;
+    uint32_t _nextSequence = 1;
+    uint16_t _boot = 0;
+};
+
+extern EventLog* eventLog;
@@ -6,13 +6,75 @@
 #include "PreferencesKeys.h"
 #include "RestartReason.h"
 #include "lib/gpio2go/src/Gpio2Go.h"
+#include "soc/gpio_struct.h"
+
+namespace
+{
+    struct RoleDescriptor
+    {
+        PinRole role;
+        bool isInput;
+        bool isOutput;
+        GpioAction action;
+        PinMode pinMode;
+        InterruptMode interruptMode;
+        const char* description;
+    };
+
+    // Indexed by PinRole, the order has to match the enum
+    constexpr RoleDescriptor roleTable[] =
+    {
+        { PinRole::Disabled, false, false, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Disabled" },
+        { PinRole::InputLock, true, false, GpioAction::Lock, PinMode::InputPullup, InterruptMode::Falling, "Input: Lock" },
+        { PinRole::InputUnlock, true, false, GpioAction::Unlock, PinMode::InputPullup, InterruptMode::Falling, "Input: Unlock" },
+        { PinRole::InputUnlatch, true, false, GpioAction::Unlatch, PinMode::InputPullup, InterruptMode::Falling, "Input: Unlatch" },
+        { PinRole::InputLockNgo, true, false, GpioAction::LockNgo, PinMode::InputPullup, InterruptMode::Falling, "Input: Lock n Go" },
+        { PinRole::InputLockNgoUnlatch, true, false, GpioAction::LockNgoUnlatch, PinMode::InputPullup, InterruptMode::Falling, "Input: Lock n Go and unlatch" },
+        { PinRole::InputElectricStrikeActuation, true, false, GpioAction::ElectricStrikeActuation, PinMode::InputPullup, InterruptMode::Falling, "Input: Electric strike actuation" },
+        { PinRole::InputActivateRTO, true, false, GpioAction::ActivateRTO, PinMode::InputPullup, InterruptMode::Falling, "Input: Activate RTO" },
+        { PinRole::InputActivateCM, true, false, GpioAction::ActivateCM, PinMode::InputPullup, InterruptMode::Falling, "Input: Activate CM" },
+        { PinRole::InputDeactivateRtoCm, true, false, GpioAction::DeactivateRtoCm, PinMode::InputPullup, InterruptMode::Falling, "Input: Deactivate RTO/CM" },
+        { PinRole::InputDeactivateRTO, true, false, GpioAction::DeactivateRTO, PinMode::InputPullup, InterruptMode::Falling, "Input: Deactivate RTO" },
+        { PinRole::InputDeactivateCM, true, false, GpioAction::DeactivateCM, PinMode::InputPullup, InterruptMode::Falling, "Input: Deactivate CM" },
+        { PinRole::OutputHighLocked, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Output: High when locked" },
+        { PinRole::OutputHighUnlocked, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Output: High when unlocked" },
+        { PinRole::OutputHighMotorBlocked, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Output: High when motor blocked" },
+        { PinRole::OutputHighRtoActive, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Output: High when RTO active" },
+        { PinRole::OutputHighCmActive, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Output: High when CM active" },
+        { PinRole::OutputHighRtoOrCmActive, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "Output: High when RTO or CM active" },
+        { PinRole::GeneralOutput, false, true, GpioAction::None, PinMode::Output, InterruptMode::Falling, "General output" },
+        { PinRole::GeneralInputPullDown, true, false, GpioAction::GeneralInput, PinMode::InputPullDown, InterruptMode::Change, "General input (Pull-down)" },
+        { PinRole::GeneralInputPullUp, true, false, GpioAction::GeneralInput, PinMode::InputPullup, InterruptMode::Change, "General input (Pull-up)" },
+    };
+
+    constexpr bool roleTableIsOrdered(size_t index = 0)
+    {
+        return index >= sizeof(roleTable) / sizeof(roleTable[0]) ||
+               ((size_t)roleTable[index].role == index && roleTableIsOrdered(index + 1));
+    }
+
+    static_assert(sizeof(roleTable) / sizeof(roleTable[0]) == GPIO_NR_OF_ROLES, "GPIO role table is incomplete");
+    static_assert(roleTableIsOrdered(), "GPIO role table has to be ordered like PinRole");
+
+    // The pins are defined by Gpio2Go, which handles their interrupts
+    constexpr uint64_t availablePins = Gpio2GoSupportedPinMask;
+
+    static_assert((availablePins >> GPIO_NR_OF_PINS) == 0, "Pins supported by Gpio2Go have to be below GPIO_NR_OF_PINS");
+
+    const RoleDescriptor& describe(const PinRole& role)
+    {
+        return (size_t)role < GPIO_NR_OF_ROLES ? roleTable[(size_t)role] : roleTable[(size_t)PinRole::Disabled];
+    }
+}
 
 Gpio* Gpio::_inst = nullptr;
-unsigned long Gpio::_debounceTs = 0;
-const uint Gpio::_debounceTime = GPIO_DEBOUNCE_TIME;
+GpioEvent Gpio::_events[GPIO_EVENT_BUFFER_SIZE];
+std::atomic<uint32_t> Gpio::_eventWriteIndex(0);
+GpioAction Gpio::_pinActions[GPIO_NR_OF_PINS];
 
 Gpio::Gpio(Preferences* preferences)
-: _preferences(preferences)
+: _availablePins(std::begin(Gpio2GoSupportedPins), std::end(Gpio2GoSupportedPins)),
+  _preferences(preferences)
 {
     _inst = this;
     loadPinConfiguration();
@@ -27,83 +89,34 @@ Gpio::Gpio(Preferences* preferences)
 
 void Gpio::init()
 {
+    memset(_inst->_outputMasks, 0, sizeof(_inst->_outputMasks));
+
     for(const auto& entry : _inst->_pinConfiguration)
     {
-        const auto it = std::find(_inst->availablePins().begin(), _inst->availablePins().end(), entry.pin);
-
-        if(it == _inst->availablePins().end())
+        if(entry.pin >= GPIO_NR_OF_PINS || (availablePins & (1ULL << entry.pin)) == 0)
         {
             continue;
         }
 
-        switch(entry.role)
+        const RoleDescriptor& descriptor = describe(entry.role);
+        _pinActions[entry.pin] = descriptor.action;
+
+        if(descriptor.isInput)
         {
-            case PinRole::InputLock:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrLock, FALLING);
-                break;
-            case PinRole::InputUnlock:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrUnlock, FALLING);
-                break;
-            case PinRole::InputUnlatch:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrUnlatch, FALLING);
-                break;
-            case PinRole::InputLockNgo:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrLockNgo, FALLING);
-                break;
-            case PinRole::InputLockNgoUnlatch:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrLockNgoUnlatch, FALLING);
-                break;
-            case PinRole::InputElectricStrikeActuation:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrElectricStrikeActuation, FALLING);
-                break;
-            case PinRole::InputActivateRTO:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrActivateRTO, FALLING);
-                break;
-            case PinRole::InputActivateCM:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrActivateCM, FALLING);
-                break;
-            case PinRole::InputDeactivateRtoCm:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrDeactivateRtoCm, FALLING);
-                break;
-            case PinRole::InputDeactivateRTO:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrDeactivateRTO, FALLING);
-                break;
-            case PinRole::InputDeactivateCM:
-                pinMode(entry.pin, INPUT_PULLUP);
-                attachInterrupt(entry.pin, isrDeactivateCM, FALLING);
-                break;
-            case PinRole::OutputHighLocked:
-            case PinRole::OutputHighUnlocked:
-            case PinRole::OutputHighMotorBlocked:
-            case PinRole::OutputHighRtoActive:
-            case PinRole::OutputHighCmActive:
-            case PinRole::OutputHighRtoOrCmActive:
-            case PinRole::GeneralOutput:
-                pinMode(entry.pin, OUTPUT);
-                break;
-            case PinRole::GeneralInputPullDown:
-                Gpio2Go::configurePin(entry.pin, PinMode::InputPullDown, InterruptMode::Change, 300);
-                break;
-            case PinRole::GeneralInputPullUp:
-                Gpio2Go::configurePin(entry.pin, PinMode::InputPullup, InterruptMode::Change, 300);
-                break;
-            default:
-                pinMode(entry.pin, OUTPUT);
-                break;
+            Gpio2Go::configurePin(entry.pin, descriptor.pinMode, descriptor.interruptMode, getDebounceTime(entry));
+        }
+        else
+        {
+            pinMode(entry.pin, OUTPUT);
         }
 
-        Gpio2Go::subscribe(Gpio::inputCallback);
+        if(descriptor.isOutput)
+        {
+            _inst->_outputMasks[(size_t)entry.role] |= (1ULL << entry.pin);
+        }
     }
+
+    Gpio2Go::subscribe(Gpio::inputCallback);
 }
 
 const std::vector<uint8_t>& Gpio::availablePins() const
@@ -144,6 +157,18 @@ void Gpio::loadPinConfiguration()
             _pinConfiguration.push_back(entry);
         }
     }
+
+    uint16_t debounceTimes[GPIO_NR_OF_PINS];
+    memset(debounceTimes, 0, sizeof(debounceTimes));
+    _preferences->getBytes(preference_gpio_debounce, debounceTimes, sizeof(debounceTimes));
+
+    for(auto& entry : _pinConfiguration)
+    {
+        if(entry.pin < GPIO_NR_OF_PINS)
+        {
+            entry.debounceTime = debounceTimes[entry.pin];
+        }
+    }
 }
 
 void Gpio::savePinConfiguration(const std::vector<PinEntry> &pinConfiguration)
@@ -164,6 +189,19 @@ void Gpio::savePinConfiguration(const std::vector<PinEntry> &pinConfiguration)
     }
 
     _preferences->putBytes(preference_gpio_configuration, serialized, sizeof(serialized));
+
+    uint16_t debounceTimes[GPIO_NR_OF_PINS];
+    memset(debounceTimes, 0, sizeof(debounceTimes));
+
+    for(const auto& entry : pinConfiguration)
+    {
+        if(entry.role != PinRole::Disabled && entry.pin < GPIO_NR_OF_PINS)
+        {
+            debounceTimes[entry.pin] = entry.debounceTime;
+        }
+    }
+
+    _preferences->putBytes(preference_gpio_debounce, debounceTimes, sizeof(debounceTimes));
 }
 
 const std::vector<PinEntry> &Gpio::pinConfiguration() const
@@ -183,57 +221,52 @@ const PinRole Gpio::getPinRole(const int &pin) const
     return PinRole::Disabled;
 }
 
-String Gpio::getRoleDescription(PinRole role) const
+uint16_t Gpio::getDebounceTime(const PinEntry& entry)
 {
-    switch(role)
+    if(entry.debounceTime != 0)
+    {
+        return entry.debounceTime;
+    }
+
+    switch(entry.role)
     {
-        case PinRole::Disabled:
-            return "Disabled";
-        case PinRole::InputLock:
-            return "Input: Lock";
-        case PinRole::InputUnlock:
-            return "Input: Unlock";
-        case PinRole::InputUnlatch:
-            return "Input: Unlatch";
-        case PinRole::InputLockNgo:
-            return "Input: Lock n Go";
-        case PinRole::InputLockNgoUnlatch:
-            return "Input: Lock n Go and unlatch";
-        case PinRole::InputElectricStrikeActuation:
-            return "Input: Electric strike actuation";
-        case PinRole::InputActivateRTO:
-            return "Input: Activate RTO";
-        case PinRole::InputActivateCM:
-            return "Input: Activate CM";
-        case PinRole::InputDeactivateRtoCm:
-            return "Input: Deactivate RTO/CM";
-        case PinRole::InputDeactivateRTO:
-            return "Input: Deactivate RTO";
-        case PinRole::InputDeactivateCM:
-            return "Input: Deactivate CM";
-        case PinRole::OutputHighLocked:
-            return "Output: High when locked";
-        case PinRole::OutputHighUnlocked:
-            return "Output: High when unlocked";
-        case PinRole::OutputHighMotorBlocked:
-            return "Output: High when motor blocked";
-        case PinRole::OutputHighRtoActive:
-            return "Output: High when RTO active";
-        case PinRole::OutputHighCmActive:
-            return "Output: High when CM active";
-        case PinRole::OutputHighRtoOrCmActive:
-            return "Output: High when RTO or CM active";
-        case PinRole::GeneralOutput:
-            return "General output";
         case PinRole::GeneralInputPullDown:
-            return "General input (Pull-down)";
         case PinRole::GeneralInputPullUp:
-            return "General input (Pull-up)";
+            return GPIO_GENERAL_INPUT_DEBOUNCE_TIME;
         default:
-            return "Unknown";
+            return GPIO_DEBOUNCE_TIME;
     }
 }
 
+bool Gpio::isInput(const PinRole& role)
+{
+    return describe(role).isInput;
+}
+
+uint64_t Gpio::getOutputMask(const PinRole& role) const
+{
+    return (size_t)role < GPIO_NR_OF_ROLES ? _outputMasks[(size_t)role] : 0;
+}
+
+unsigned long Gpio::getLastEdgeTs(const uint8_t& pin) const
+{
+    return Gpio2Go::getLastEdgeMillis(pin);
+}
+
+void Gpio::getEdgeStatistics(const uint8_t& pin, uint32_t& edgesSeen, uint32_t& edgesSuppressed) const
+{
+    Gpio2Go::getEdgeStatistics(pin, edgesSeen, edgesSuppressed);
+}
+
+String Gpio::getRoleDescription(PinRole role) const
+{
+    if((size_t)role >= GPIO_NR_OF_ROLES)
+    {
+        return "Unknown";
+    }
+    return describe(role).description;
+}
+
 void Gpio::getConfigurationText(String& text, const std::vector<PinEntry>& pinConfiguration, const String& linebreak) const
 {
     for(const auto& entry : pinConfiguration)
@@ -258,104 +291,86 @@ const std::vector<PinRole>& Gpio::getAllRoles() const
     return _allRoles;
 }
 
-void Gpio::notify(const GpioAction &action, const int& pin)
-{
-    for(auto& callback : _callbacks)
-    {
-        callback(action, pin);
-    }
-}
-
-void Gpio::inputCallback(const int &pin)
+void Gpio::pushEvent(const GpioAction &action, const int& pin)
 {
-    _inst->notify(GpioAction::GeneralInput, pin);
+    // All GPIO interrupts are dispatched by the same handler on one core, so there is only ever one producer.
+    // Consumers that fall more than GPIO_EVENT_BUFFER_SIZE events behind lose the oldest ones.
+    uint32_t writeIndex = _eventWriteIndex.load(std::memory_order_relaxed);
+    GpioEvent& event = _events[writeIndex & (GPIO_EVENT_BUFFER_SIZE - 1)];
+    event.action = action;
+    event.pin = pin;
+    event.timestamp = millis();
+    _eventWriteIndex.store(writeIndex + 1, std::memory_order_release);
 }
 
-void Gpio::addCallback(std::function<void(const GpioAction&, const int&)> callback)
+void Gpio::processEvents(const int& subscriberId)
 {
-    _callbacks.push_back(callback);
-}
-
-void Gpio::isrLock()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::Lock, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+    if(subscriberId < 0 || subscriberId >= _subscriberCount)
+    {
+        return;
+    }
 
-void Gpio::isrUnlock()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::Unlock, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+    GpioSubscriber& subscriber = _subscribers[subscriberId];
 
-void Gpio::isrUnlatch()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::Unlatch, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+    while(true)
+    {
+        uint32_t writeIndex = _eventWriteIndex.load(std::memory_order_acquire);
+        if(subscriber.readIndex == writeIndex)
+        {
+            break;
+        }
 
-void Gpio::isrLockNgo()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::LockNgo, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+        if(writeIndex - subscriber.readIndex > GPIO_EVENT_BUFFER_SIZE)
+        {
+            Log->print(F("GPIO event buffer overrun, events dropped: "));
+            Log->println(writeIndex - subscriber.readIndex - GPIO_EVENT_BUFFER_SIZE);
+            subscriber.readIndex = writeIndex - GPIO_EVENT_BUFFER_SIZE;
+        }
 
-void Gpio::isrLockNgoUnlatch()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::LockNgoUnlatch, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+        GpioEvent event = _events[subscriber.readIndex & (GPIO_EVENT_BUFFER_SIZE - 1)];
 
-void Gpio::isrElectricStrikeActuation()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::ElectricStrikeActuation, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+        // The slot may have been overwritten by an ISR while copying it
+        if(_eventWriteIndex.load(std::memory_order_acquire) - subscriber.readIndex > GPIO_EVENT_BUFFER_SIZE)
+        {
+            continue;
+        }
 
-void Gpio::isrActivateRTO()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::ActivateRTO, -1);
-    _debounceTs = millis() + _debounceTime;
+        ++subscriber.readIndex;
+        subscriber.callback(event.action, event.pin);
+    }
 }
 
-void Gpio::isrActivateCM()
+void Gpio::inputCallback(const int &pin)
 {
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::ActivateCM, -1);
-    _debounceTs = millis() + _debounceTime;
+    pushEvent(_pinActions[pin], pin);
 }
 
-void Gpio::isrDeactivateRtoCm()
+int Gpio::addCallback(std::function<void(const GpioAction&, const int&)> callback)
 {
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::DeactivateRtoCm, -1);
-    _debounceTs = millis() + _debounceTime;
-}
+    if(_subscriberCount >= GPIO_MAX_SUBSCRIBERS)
+    {
+        Log->println(F("GPIO: Maximum number of subscribers reached"));
+        return -1;
+    }
 
-void Gpio::isrDeactivateRTO()
-{
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::DeactivateRTO, -1);
-    _debounceTs = millis() + _debounceTime;
+    GpioSubscriber& subscriber = _subscribers[_subscriberCount];
+    subscriber.callback = callback;
+    subscriber.readIndex = _eventWriteIndex.load(std::memory_order_acquire);
+    return _subscriberCount++;
 }
 
-void Gpio::isrDeactivateCM()
+void Gpio::setPinOutput(const uint8_t& pin, const uint8_t& state)
 {
-    if(millis() < _debounceTs) return;
-    _inst->notify(GpioAction::DeactivateCM, -1);
-    _debounceTs = millis() + _debounceTime;
+    digitalWrite(pin, state);
 }
 
-void Gpio::setPinOutput(const uint8_t& pin, const uint8_t& state)
+void Gpio::setOutputs(const uint64_t& highMask, const uint64_t& lowMask)
 {
-    digitalWrite(pin, state);
+    // Write-one-to-set/clear registers, pins 0-31 and 32-39 are in separate banks
+    GPIO.out_w1tc = (uint32_t)lowMask;
+    GPIO.out1_w1tc.val = (uint32_t)(lowMask >> 32);
+    GPIO.out_w1ts = (uint32_t)highMask;
+    GPIO.out1_w1ts.val = (uint32_t)(highMask >> 32);
 }
 
 void Gpio::migrateObsoleteSetting()
@@ -3,6 +3,11 @@
 #include <functional>
 #include <Preferences.h>
 #include <vector>
+#include <atomic>
+
+#define GPIO_EVENT_BUFFER_SIZE 16 // must be a power of two
+#define GPIO_MAX_SUBSCRIBERS 4
+#define GPIO_NR_OF_PINS 40
 
 enum class PinRole
 {
@@ -29,6 +34,8 @@ enum class PinRole
     GeneralInputPullUp
 };
 
+#define GPIO_NR_OF_ROLES ((size_t)PinRole::GeneralInputPullUp + 1)
+
 enum class GpioAction
 {
     Lock,
@@ -42,13 +49,22 @@ enum class GpioAction
     DeactivateRtoCm,
     DeactivateRTO,
     DeactivateCM,
-    GeneralInput
+    GeneralInput,
+    None
 };
 
 struct PinEntry
 {
     uint8_t pin = 0;
     PinRole role = PinRole::Disabled;
+    uint16_t debounceTime = 0; // ms, 0 = default for the role
+};
+
+struct GpioEvent
+{
+    GpioAction action;
+    int8_t pin;
+    unsigned long timestamp;
 };
 
 class Gpio
@@ -59,7 +75,10 @@ public:
 
     void migrateObsoleteSetting();
 
-    void addCallback(std::function<void(const GpioAction&, const int&)> callback);
+    // Returns the subscriber id to pass to processEvents(), or -1 if no slot is left
+    int addCallback(std::function<void(const GpioAction&, const int&)> callback);
+    // Runs the subscriber's callback for all events queued by the ISRs since the last call, in the calling task
+    void processEvents(const int& subscriberId);
 
     void loadPinConfiguration();
     void savePinConfiguration(const std::vector<PinEntry>& pinConfiguration);
@@ -67,6 +86,11 @@ public:
     const std::vector<uint8_t>& availablePins() const;
     const std::vector<PinEntry>& pinConfiguration() const;
     const PinRole getPinRole(const int& pin) const;
+    static uint16_t getDebounceTime(const PinEntry& entry);
+    static bool isInput(const PinRole& role);
+
+    unsigned long getLastEdgeTs(const uint8_t& pin) const;
+    void getEdgeStatistics(const uint8_t& pin, uint32_t& edgesSeen, uint32_t& edgesSuppressed) const;
 
     String getRoleDescription(PinRole role) const;
     void getConfigurationText(String& text, const std::vector<PinEntry>& pinConfiguration, const String& linebreak = "\n") const;
@@ -75,11 +99,22 @@ public:
 
     void setPinOutput(const uint8_t& pin, const uint8_t& state);
 
+    // Bitmask (bit n = GPIO n) of the pins configured for an output role, computed once in init()
+    uint64_t getOutputMask(const PinRole& role) const;
+    // Drives all pins in highMask high and all pins in lowMask low with one register write per bank
+    void setOutputs(const uint64_t& highMask, const uint64_t& lowMask);
+
 private:
-    void IRAM_ATTR notify(const GpioAction& action, const int& pin);
-    static void inputCallback(const int & pin);
+    struct GpioSubscriber
+    {
+        std::function<void(const GpioAction&, const int&)> callback;
+        uint32_t readIndex = 0;
+    };
+
+    static void IRAM_ATTR pushEvent(const GpioAction& action, const int& pin);
+    static void IRAM_ATTR inputCallback(const int & pin);
 
-    const std::vector<uint8_t> _availablePins = { 2, 4, 5, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 32, 33 };
+    const std::vector<uint8_t> _availablePins;
     const std::vector<PinRole> _allRoles =
         {
             PinRole::Disabled,
@@ -105,24 +140,17 @@ private:
         };
 
     std::vector<PinEntry> _pinConfiguration;
-    static const uint _debounceTime;
-
-    static void IRAM_ATTR isrLock();
-    static void IRAM_ATTR isrUnlock();
-    static void IRAM_ATTR isrUnlatch();
-    static void IRAM_ATTR isrLockNgo();
-    static void IRAM_ATTR isrLockNgoUnlatch();
-    static void IRAM_ATTR isrElectricStrikeActuation();
-    static void IRAM_ATTR isrActivateRTO();
-    static void IRAM_ATTR isrActivateCM();
-    static void IRAM_ATTR isrDeactivateRtoCm();
-    static void IRAM_ATTR isrDeactivateRTO();
-    static void IRAM_ATTR isrDeactivateCM();
-
-    std::vector<std::function<void(const GpioAction&, const int&)>> _callbacks;
+    uint64_t _outputMasks[GPIO_NR_OF_ROLES] = {0};
+
+    GpioSubscriber _subscribers[GPIO_MAX_SUBSCRIBERS];
+    int _subscriberCount = 0;
+
+    static GpioEvent DRAM_ATTR _events[GPIO_EVENT_BUFFER_SIZE];
+    static std::atomic<uint32_t> _eventWriteIndex;
+
+    static GpioAction DRAM_ATTR _pinActions[GPIO_NR_OF_PINS];
 
     static Gpio* _inst;
-    static unsigned long _debounceTs;
 
     Preferences* _preferences = nullptr;
 };
@@ -0,0 +1,235 @@
+#include "HttpOta.h"
+#include "Logger.h"
+#include "RestartReason.h"
+
+HttpOta::HttpOta(Ota* ota, Network* network)
+: _ota(ota),
+  _network(network)
+{}
+
+bool HttpOta::start(const String& url)
+{
+    if(_taskHandle != nullptr || _ota->updateStarted())
+    {
+        Log->println(F("OTA: Update already in progress."));
+        return false;
+    }
+    if(url.length() == 0)
+    {
+        Log->println(F("OTA: No mirror URL configured."));
+        return false;
+    }
+
+    _url = url;
+    xTaskCreatePinnedToCore(task, "httpota", 6144, this, 1, &_taskHandle, 1);
+    return true;
+}
+
+bool HttpOta::isRunning()
+{
+    return _taskHandle != nullptr;
+}
+
+void HttpOta::task(void* param)
+{
+    HttpOta* httpOta = (HttpOta*)param;
+    httpOta->run();
+    httpOta->_taskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void HttpOta::run()
+{
+    Log->print(F("OTA: Downloading firmware from ")); Log->println(_url);
+    _network->publishOtaState("started");
+
+    memset(_digest, 0, sizeof(_digest));
+    if(!fetchDigest(_digest))
+    {
+        Log->println(F("OTA: No SHA-256 digest found on mirror, image will only be validated by the bootloader checks."));
+    }
+
+    bool success = false;
+    size_t totalSize = 0;
+    _progressReportedSize = 0;
+
+    if(_ota->begin(_digest))
+    {
+        for(int attempt = 0; attempt < HTTP_OTA_MAX_ATTEMPTS && !success; attempt++)
+        {
+            if(attempt > 0)
+            {
+                Log->print(F("OTA: Download interrupted, resuming at byte ")); Log->println(_ota->bytesWritten());
+                delay(HTTP_OTA_RETRY_DELAY);
+            }
+            success = download(totalSize);
+        }
+
+        if(success)
+        {
+            success = _ota->end();
+        }
+        else
+        {
+            _ota->abort();
+        }
+    }
+
+    _network->publishOtaProgress(_ota->bytesWritten());
+    _network->publishOtaState(success ? "completed" : "failed");
+
+    delay(1000);
+    if(success)
+    {
+        restartEsp(RestartReason::OTACompleted);
+    }
+    else
+    {
+        restartEsp(RestartReason::OTAAborted);
+    }
+}
+
+bool HttpOta::fetchDigest(char* digest)
+{
+    // The mirror is expected to provide the digest as "<binary url>.sha256", e.g. the output of sha256sum
+    HTTPClient http;
+    http.begin(_url + ".sha256");
+    int httpResponseCode = http.GET();
+
+    bool found = false;
+    if(httpResponseCode == HTTP_CODE_OK)
+    {
+        WiFiClient* stream = http.getStreamPtr();
+        size_t len = stream->readBytes(digest, OTA_SHA256_HEX_LENGTH);
+        digest[len] = 0;
+        found = len == OTA_SHA256_HEX_LENGTH;
+    }
+    http.end();
+
+    if(!found)
+    {
+        digest[0] = 0;
+    }
+    return found;
+}
+
+bool HttpOta::download(size_t& totalSize)
+{
+    HTTPClient http;
+    http.begin(_url);
+
+    size_t offset = _ota->bytesWritten();
+    if(offset > 0)
+    {
+        char range[32];
+        sprintf(range, "bytes=%u-", offset);
+        http.addHeader("Range", range);
+    }
+
+    const char* headerKeys[] = { "Content-Range" };
+    http.collectHeaders(headerKeys, 1);
+
+    int httpResponseCode = http.GET();
+
+    if(offset > 0 && httpResponseCode == HTTP_CODE_OK)
+    {
+        // Mirror doesn't support range requests, start over
+        Log->println(F("OTA: Mirror ignored range request, restarting download."));
+        _ota->abort();
+        if(!_ota->begin(_digest))
+        {
+            http.end();
+            return false;
+        }
+        offset = 0;
+        totalSize = 0;
+        _progressReportedSize = 0;
+    }
+    else if(httpResponseCode == HTTP_CODE_PARTIAL_CONTENT)
+    {
+        // "bytes <first>-<last>/<total>", the total may be "*"
+        const String contentRange = http.header("Content-Range");
+        unsigned long first = 0;
+        unsigned long last = 0;
+        unsigned long total = 0;
+        const int fields = sscanf(contentRange.c_str(), "bytes %lu-%lu/%lu", &first, &last, &total);
+        if(offset == 0 || fields < 2 || first != offset)
+        {
+            Log->print(F("OTA: Unexpected content range: ")); Log->println(contentRange);
+            http.end();
+            return false;
+        }
+        if(fields == 3 && total > 0)
+        {
+            totalSize = total;
+        }
+    }
+    else if(httpResponseCode != HTTP_CODE_OK)
+    {
+        Log->print(F("OTA: HTTP request failed: ")); Log->println(httpResponseCode);
+        http.end();
+        return false;
+    }
+
+    int size = http.getSize();
+    if(totalSize == 0 && size > 0)
+    {
+        totalSize = offset + size;
+    }
+
+    WiFiClient* stream = http.getStreamPtr();
+    uint8_t buf[HTTP_OTA_READ_BUFFER_SIZE];
+    unsigned long lastDataTs = millis();
+    bool closed = false;
+
+    while(totalSize == 0 || _ota->bytesWritten() < totalSize)
+    {
+        size_t available = stream->available();
+        if(available > 0)
+        {
+            size_t len = stream->readBytes(buf, std::min(available, sizeof(buf)));
+            if(!_ota->write(buf, len))
+            {
+                http.end();
+                return false;
+            }
+            lastDataTs = millis();
+
+            if(_ota->bytesWritten() - _progressReportedSize >= OTA_PROGRESS_INTERVAL)
+            {
+                _progressReportedSize = _ota->bytesWritten();
+                _network->publishOtaProgress(_progressReportedSize);
+            }
+        }
+        else if(!stream->connected())
+        {
+            closed = true;
+            break;
+        }
+        else if(millis() - lastDataTs > HTTP_OTA_STALL_TIMEOUT)
+        {
+            // Interrupted, resumed with the next attempt
+            break;
+        }
+        else
+        {
+            delay(1);
+        }
+    }
+
+    http.end();
+
+    if(totalSize > 0)
+    {
+        return _ota->bytesWritten() == totalSize;
+    }
+
+    // Without a content length the end of the image is only known by the server closing the connection. A connection
+    // closed early can't be told apart from that, so it is only accepted if the digest verifies the image.
+    if(closed && _digest[0] == 0)
+    {
+        Log->println(F("OTA: Mirror sent neither content length nor digest, can't verify that the image is complete."));
+        return false;
+    }
+    return closed && _ota->bytesWritten() > 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include "Ota.h"
+#include "Network.h"
+
+#define HTTP_OTA_MAX_ATTEMPTS 5
+#define HTTP_OTA_STALL_TIMEOUT 10000 // ms without data until the connection is considered interrupted
+#define HTTP_OTA_RETRY_DELAY 2000
+#define HTTP_OTA_READ_BUFFER_SIZE 1436
+
+class HttpOta
+{
+public:
+    HttpOta(Ota* ota, Network* network);
+
+    bool start(const String& url);
+    bool isRunning();
+
+private:
+    static void task(void* param);
+    void run();
+    bool fetchDigest(char* digest);
+    bool download(size_t& totalSize);
+
+    Ota* _ota;
+    Network* _network;
+    String _url;
+    char _digest[OTA_SHA256_HEX_LENGTH + 1] = {0};
+    size_t _progressReportedSize = 0;
+    TaskHandle_t _taskHandle = nullptr;
+};
@@ -1,3 +1,4 @@
 #include "Logger.h"
 
 Print* Log = nullptr;
+AsyncLogger* AsyncLog = nullptr;
@@ -1,7 +1,26 @@
 #ifndef MQTT_LOGGER_GLOBAL
 #define MQTT_LOGGER_GLOBAL
 
-#include "MqttLogger.h"
+#include "AsyncLogger.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef NUKI_HUB_LOG_LEVEL
+#define NUKI_HUB_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Statements logged through these are removed at compile time when above NUKI_HUB_LOG_LEVEL,
+// e.g. LogDebug->println(F("...")). Plain Log-> statements are always compiled in.
+#define LogError if(NUKI_HUB_LOG_LEVEL < LOG_LEVEL_ERROR) {} else Log
+#define LogWarning if(NUKI_HUB_LOG_LEVEL < LOG_LEVEL_WARNING) {} else Log
+#define LogInfo if(NUKI_HUB_LOG_LEVEL < LOG_LEVEL_INFO) {} else Log
+#define LogDebug if(NUKI_HUB_LOG_LEVEL < LOG_LEVEL_DEBUG) {} else Log
+
 extern Print* Log;
+extern AsyncLogger* AsyncLog;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,86 @@
+#include "LoopTiming.h"
+
+static TimingHistogram histograms[(int)TimingId::Count];
+
+void TimingHistogram::record(const uint32_t& durationUs)
+{
+    size_t index = durationUs == 0 ? 0 : 31 - __builtin_clz(durationUs);
+    if(index >= LOOP_TIMING_BUCKETS)
+    {
+        index = LOOP_TIMING_BUCKETS - 1;
+    }
+
+    _buckets[index].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t max = _max.load(std::memory_order_relaxed);
+    while(durationUs > max && !_max.compare_exchange_weak(max, durationUs, std::memory_order_relaxed))
+    {
+    }
+}
+
+void TimingHistogram::mark()
+{
+    const uint32_t now = micros();
+    if(_lastMarkUs != 0)
+    {
+        record(now - _lastMarkUs);
+    }
+    _lastMarkUs = now;
+}
+
+uint32_t TimingHistogram::count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+uint32_t TimingHistogram::bucket(const size_t& index) const
+{
+    return _buckets[index].load(std::memory_order_relaxed);
+}
+
+uint32_t TimingHistogram::takeMax()
+{
+    return _max.exchange(0, std::memory_order_relaxed);
+}
+
+ScopedTiming::ScopedTiming(const TimingId& id)
+: _histogram(loopTiming(id)),
+  _startUs(micros())
+{
+}
+
+ScopedTiming::~ScopedTiming()
+{
+    _histogram.record(micros() - _startUs);
+}
+
+TimingHistogram& loopTiming(const TimingId& id)
+{
+    return histograms[(int)id];
+}
+
+const char* timingName(const TimingId& id)
+{
+    switch(id)
+    {
+        case TimingId::NetworkLoop:
+            return "networkLoop";
+        case TimingId::NukiLoop:
+            return "nukiLoop";
+        case TimingId::PresenceLoop:
+            return "presenceLoop";
+        case TimingId::NetworkUpdate:
+            return "networkUpdate";
+        case TimingId::WebCfgUpdate:
+            return "webCfgUpdate";
+        case TimingId::LockUpdate:
+            return "lockUpdate";
+        case TimingId::OpenerUpdate:
+            return "openerUpdate";
+        case TimingId::BleScannerUpdate:
+            return "bleScannerUpdate";
+        default:
+            return "unknown";
+    }
+}
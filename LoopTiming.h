@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#define LOOP_TIMING_BUCKETS 24 // bucket n counts durations of 2^n to 2^(n+1)-1 µs, the last one everything above
+#define LOOP_TIMING_JSON_SIZE 4096
+
+enum class TimingId
+{
+    NetworkLoop,
+    NukiLoop,
+    PresenceLoop,
+    NetworkUpdate,
+    WebCfgUpdate,
+    LockUpdate,
+    OpenerUpdate,
+    BleScannerUpdate,
+    Count
+};
+
+// Duration histogram with log2 buckets. Each histogram is recorded by one task only, the counters are
+// cumulative and can be read from any task. The maximum is reset by takeMax().
+class TimingHistogram
+{
+public:
+    void record(const uint32_t& durationUs);
+    // Records the time since the previous mark(), used for the period of a task loop
+    void mark();
+
+    uint32_t count() const;
+    uint32_t bucket(const size_t& index) const;
+    uint32_t takeMax();
+
+private:
+    std::atomic<uint32_t> _buckets[LOOP_TIMING_BUCKETS] = {};
+    std::atomic<uint32_t> _count{0};
+    std::atomic<uint32_t> _max{0};
+    uint32_t _lastMarkUs = 0;
+};
+
+// Records the lifetime of the object, e.g. the duration of a call
+class ScopedTiming
+{
+public:
+    explicit ScopedTiming(const TimingId& id);
+    ~ScopedTiming();
+
+private:
+    TimingHistogram& _histogram;
+    uint32_t _startUs;
+};
+
+TimingHistogram& loopTiming(const TimingId& id);
+const char* timingName(const TimingId& id);
@@ -58,18 +58,30 @@
 #define mqtt_topic_keypad_json "/keypad/json"
 
 #define mqtt_topic_presence "/presence/devices"
+#define mqtt_topic_presence_events "/presence/events"
+#define mqtt_topic_presence_refresh "/presence/refresh"
 
 #define mqtt_topic_reset "/maintenance/reset"
 #define mqtt_topic_uptime "/maintenance/uptime"
 #define mqtt_topic_wifi_rssi "/maintenance/wifiRssi"
 #define mqtt_topic_log "/maintenance/log"
 #define mqtt_topic_freeheap "/maintenance/freeHeap"
+#define mqtt_topic_heap "/maintenance/heap"
+#define mqtt_topic_tasks "/maintenance/tasks"
+#define mqtt_topic_loop_timing "/maintenance/loopTiming"
 #define mqtt_topic_restart_reason_fw "/maintenance/restartReasonNukiHub"
 #define mqtt_topic_restart_reason_esp "/maintenance/restartReasonNukiEsp"
 #define mqtt_topic_mqtt_connection_state "/maintenance/mqttConnectionState"
 #define mqtt_topic_network_device "/maintenance/networkDevice"
+#define mqtt_topic_ota_update "/maintenance/otaUpdate"
+#define mqtt_topic_ota_state "/maintenance/otaState"
+#define mqtt_topic_ota_progress "/maintenance/otaProgress"
+#define mqtt_topic_event_log "/maintenance/eventLog"
+#define mqtt_topic_event_log_export "/maintenance/eventLogExport"
 
 #define mqtt_topic_gpio_prefix "/gpio"
 #define mqtt_topic_gpio_pin "/pin_"
 #define mqtt_topic_gpio_role "/role"
 #define mqtt_topic_gpio_state "/state"
+#define mqtt_topic_gpio_edges_seen "/edgesSeen"
+#define mqtt_topic_gpio_edges_suppressed "/edgesSuppressed"
@@ -5,7 +5,9 @@
 #include "Logger.h"
 #include "Config.h"
 #include <ArduinoJson.h>
+#include <algorithm>
 #include "RestartReason.h"
+#include "EventLog.h"
 #include "networkDevices/EthLan8720Device.h"
 
 Network* Network::_inst = nullptr;
@@ -212,6 +214,14 @@ void Network::initialize()
     _device->mqttSetClientId(_hostnameArr);
     _device->mqttSetCleanSession(MQTT_CLEAN_SESSIONS);
 
+    _mqttV5 = _preferences->getBool(preference_mqtt_v5);
+    if(_mqttV5)
+    {
+        _device->mqttSetProtocolVersion(5);
+        // MQTT 5 ends the session on disconnect unless an expiry interval is set
+        _device->mqttSetSessionExpiryInterval(MQTT_SESSION_EXPIRY_INTERVAL);
+    }
+
     _networkTimeout = _preferences->getInt(preference_network_timeout);
     if(_networkTimeout == 0)
     {
@@ -221,6 +231,16 @@ void Network::initialize()
 
     _publishDebugInfo = _preferences->getBool(preference_publish_debug_info);
 
+    _updateCheckUrl = _preferences->getString(preference_update_check_url);
+    if(_updateCheckUrl == "")
+    {
+        _updateCheckUrl = GITHUB_LATEST_RELEASE_API_URL;
+    }
+
+    initTopic(_maintenancePathPrefix, mqtt_topic_event_log_export, "0");
+    subscribe(_maintenancePathPrefix, mqtt_topic_event_log_export);
+    addTopicAlias(_maintenancePathPrefix, mqtt_topic_wifi_rssi);
+
     char gpioPath[250];
     bool rebGpio = rebuildGpio();
 
@@ -255,7 +275,7 @@ void Network::initialize()
                 break;
         }
     }
-    _gpio->addCallback([this](const GpioAction& action, const int& pin)
+    _gpioSubscriberId = _gpio->addCallback([this](const GpioAction& action, const int& pin)
     {
         gpioActionCallback(action, pin);
     });
@@ -301,9 +321,9 @@ bool Network::update()
 
     }
 
-    if(!_device->mqttConnected())
+    if(!_device->mqttConnected() || _reconnectState == MqttReconnectState::Connecting)
     {
-        if(_networkTimeout > 0 && (ts - _lastConnectedTs > _networkTimeout * 1000) && ts > 60000)
+        if(!_device->mqttConnected() && _networkTimeout > 0 && (ts - _lastConnectedTs > _networkTimeout * 1000) && ts > 60000)
         {
             Log->println("Network timeout has been reached, restarting ...");
             delay(200);
@@ -319,15 +339,11 @@ bool Network::update()
 
     _lastConnectedTs = ts;
 
-    if(_presenceCsv != nullptr && strlen(_presenceCsv) > 0)
+    publishPresence();
+
+    if(_eventLogExportRequested)
     {
-        bool success = publishString(_mqttPresencePrefix, mqtt_topic_presence, _presenceCsv);
-        if(!success)
-        {
-            Log->println(F("Failed to publish presence CSV data."));
-            Log->println(_presenceCsv);
-        }
-        _presenceCsv = nullptr;
+        publishEventLog();
     }
 
     if(_device->signalStrength() != 127 && _rssiPublishInterval > 0 && ts - _lastRssiTs > _rssiPublishInterval)
@@ -358,70 +374,96 @@ bool Network::update()
         _lastMaintenanceTs = ts;
     }
 
+    if(_lastTelemetryTs == 0 || (ts - _lastTelemetryTs) > TELEMETRY_PUBLISH_INTERVAL)
+    {
+        _lastTelemetryTs = ts;
+        publishTelemetry();
+    }
+
     if(_preferences->getBool(preference_check_updates))
     {
-        if(_lastUpdateCheckTs == 0 || (ts - _lastUpdateCheckTs) > 86400000)
+        if(_updateCheckTaskHandle == nullptr && (_lastUpdateCheckTs == 0 || (ts - _lastUpdateCheckTs) > 86400000))
         {
             _lastUpdateCheckTs = ts;
+            xTaskCreatePinnedToCore(updateCheckTask, "updchk", 8192, this, 1, &_updateCheckTaskHandle, 1);
+        }
+    }
 
-            https.useHTTP10(true);
-            https.begin(GITHUB_LATEST_RELEASE_API_URL);
+    if(_latestVersionReceived)
+    {
+        _latestVersionReceived = false;
+        publishString(_maintenancePathPrefix, mqtt_topic_info_nuki_hub_latest, _latestVersion);
 
-            int httpResponseCode = https.GET();
+        if(_preferences->getString(preference_latest_version) != _latestVersion)
+        {
+            _preferences->putString(preference_latest_version, _latestVersion);
+        }
+    }
 
-            if (httpResponseCode == HTTP_CODE_OK || httpResponseCode == HTTP_CODE_MOVED_PERMANENTLY) 
-            {
-                DynamicJsonDocument doc(6144);
-                DeserializationError jsonError = deserializeJson(doc, https.getStream());
+    _gpio->processEvents(_gpioSubscriberId);
 
-                if (!jsonError) 
-                {
-                    _latestVersion = doc["tag_name"];
-                    publishString(_maintenancePathPrefix, mqtt_topic_info_nuki_hub_latest, _latestVersion);
-                    
-                    if (_latestVersion != _preferences->getString(preference_latest_version).c_str()) 
-                    {
-                        _preferences->putString(preference_latest_version, _latestVersion); 
-                    }
-                }
-            }
+    if(_gpioPendingMask != 0)
+    {
+        publishGpioStates();
+    }
 
-            https.end();
-        }
+    if(ts - _lastGpioStatisticsTs > GPIO_STATISTICS_PUBLISH_INTERVAL)
+    {
+        _lastGpioStatisticsTs = ts;
+        publishGpioStatistics();
     }
 
-    for(const auto& gpioTs : _gpioTs)
+    return true;
+}
+
+
+void Network::updateCheckTask(void* param)
+{
+    Network* network = (Network*)param;
+    network->checkLatestVersion();
+    network->_updateCheckTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+void Network::checkLatestVersion()
+{
+    // Runs in its own task, the TLS handshake and download would otherwise stall MQTT processing
+    HTTPClient https;
+    https.useHTTP10(true);
+    https.begin(_updateCheckUrl);
+
+    int httpResponseCode = https.GET();
+
+    if (httpResponseCode == HTTP_CODE_OK || httpResponseCode == HTTP_CODE_MOVED_PERMANENTLY)
     {
-        uint8_t pin = gpioTs.first;
-        unsigned long ts = gpioTs.second;
-        if(ts != 0 && ((millis() - ts) >= GPIO_DEBOUNCE_TIME))
-        {
-            _gpioTs[pin] = 0;
+        // Only tag_name is kept while streaming the release JSON, the rest of the document is skipped
+        StaticJsonDocument<32> filter;
+        filter["tag_name"] = true;
 
-            uint8_t pinState = digitalRead(pin) == HIGH ? 1 : 0;
-            char gpioPath[250];
-            buildMqttPath(gpioPath, {mqtt_topic_gpio_prefix, (mqtt_topic_gpio_pin + std::to_string(pin)).c_str(), mqtt_topic_gpio_state});
-            publishInt(_lockPath.c_str(), gpioPath, pinState);
+        StaticJsonDocument<128> doc;
+        DeserializationError jsonError = deserializeJson(doc, https.getStream(), DeserializationOption::Filter(filter));
 
-            Log->print(F("GPIO "));
-            Log->print(pin);
-            Log->print(F(" (Input) --> "));
-            Log->println(pinState);
+        if (!jsonError && doc["tag_name"].is<const char*>())
+        {
+            memset(_latestVersion, 0, sizeof(_latestVersion));
+            strncpy(_latestVersion, doc["tag_name"], sizeof(_latestVersion) - 1);
+            _latestVersionReceived = true;
         }
     }
 
-    return true;
+    https.end();
 }
 
-
 void Network::onMqttConnect(const bool &sessionPresent)
 {
+    _sessionPresent = sessionPresent;
     _connectReplyReceived = true;
 }
 
 void Network::onMqttDisconnect(const espMqttClientTypes::DisconnectReason &reason)
 {
     _connectReplyReceived = true;
+    eventLog->record(EventId::MqttDisconnected, (uint32_t)reason);
 
     Log->print("MQTT disconnected. Reason: ");
     switch(reason)
@@ -431,6 +473,12 @@ void Network::onMqttDisconnect(const espMqttClientTypes::DisconnectReason &reaso
             break;
         case espMqttClientTypes::DisconnectReason::MQTT_UNACCEPTABLE_PROTOCOL_VERSION:
             Log->println(F("MQTT_UNACCEPTABLE_PROTOCOL_VERSION"));
+            if(_mqttV5)
+            {
+                Log->println(F("Broker doesn't support MQTT 5, falling back to MQTT 3.1.1"));
+                _mqttV5 = false;
+                _device->mqttSetProtocolVersion(4);
+            }
             break;
         case espMqttClientTypes::DisconnectReason::MQTT_IDENTIFIER_REJECTED:
             Log->println(F("MQTT_IDENTIFIER_REJECTED"));
@@ -458,89 +506,171 @@ void Network::onMqttDisconnect(const espMqttClientTypes::DisconnectReason &reaso
 
 bool Network::reconnect()
 {
-    _mqttConnectionState = 0;
-    int port = _preferences->getInt(preference_mqtt_broker_port);
+    unsigned long ts = millis();
 
-    while (!_device->mqttConnected() && millis() > _nextReconnect)
+    switch(_reconnectState)
     {
-        if(strcmp(_mqttBrokerAddr, "") == 0)
-        {
-            Log->println(F("MQTT Broker not configured, aborting connection attempt."));
-            _nextReconnect = millis() + 5000;
+        case MqttReconnectState::Waiting:
+            if(_mqttConnectionState > 0)
+            {
+                // Connection just dropped. Don't reconnect right away, if the broker restarted all hubs would reconnect at once.
+                _mqttConnectionState = 0;
+                _reconnectBackoff = MQTT_RECONNECT_BACKOFF_MIN;
+                scheduleReconnect();
+                return false;
+            }
+
+            if((long)(ts - _nextReconnect) < 0)
+            {
+                return false;
+            }
+
+            if(strcmp(_mqttBrokerAddr, "") == 0)
+            {
+                Log->println(F("MQTT Broker not configured, aborting connection attempt."));
+                _nextReconnect = ts + 5000;
+                return false;
+            }
+
+            startMqttConnect();
             return false;
-        }
 
-        Log->println(F("Attempting MQTT connection"));
+        case MqttReconnectState::Connecting:
+            if(_device->mqttConnected())
+            {
+                _reconnectState = MqttReconnectState::Waiting;
+                _reconnectBackoff = MQTT_RECONNECT_BACKOFF_MIN;
+                onMqttConnected();
+                return true;
+            }
 
-        _connectReplyReceived = false;
+            if(!_connectReplyReceived && (long)(ts - _connectTimeoutTs) < 0)
+            {
+                return false;
+            }
 
-        if(strlen(_mqttUser) == 0)
-        {
-            Log->println(F("MQTT: Connecting without credentials"));
-        }
-        else
-        {
-            Log->print(F("MQTT: Connecting with user: ")); Log->println(_mqttUser);
-            _device->mqttSetCredentials(_mqttUser, _mqttPass);
-        }
+            Log->print(F("MQTT connect failed, rc="));
+            _device->printError();
+            eventLog->record(EventId::MqttConnectFailed);
+            _device->mqttDisconnect(true);
+            _reconnectState = MqttReconnectState::Waiting;
+            scheduleReconnect();
+            return false;
+    }
+    return false;
+}
 
-        _device->setWill(_mqttConnectionStateTopic, 1, true, _lastWillPayload);
-        _device->mqttSetServer(_mqttBrokerAddr, port);
-        _device->mqttConnect();
+void Network::startMqttConnect()
+{
+    Log->println(F("Attempting MQTT connection"));
 
-        unsigned long timeout = millis() + 60000;
+    _connectReplyReceived = false;
+    _sessionPresent = false;
 
-        while(!_connectReplyReceived && millis() < timeout)
+    if(strlen(_mqttUser) == 0)
+    {
+        LogDebug->println(F("MQTT: Connecting without credentials"));
+    }
+    else
+    {
+        LogDebug->print(F("MQTT: Connecting with user: ")); LogDebug->println(_mqttUser);
+        _device->mqttSetCredentials(_mqttUser, _mqttPass);
+    }
+
+    _device->setWill(_mqttConnectionStateTopic, 1, true, _lastWillPayload);
+    _device->mqttSetServer(_mqttBrokerAddr, _preferences->getInt(preference_mqtt_broker_port));
+    _device->mqttConnect();
+
+    // The CONNACK or the disconnect is processed by _device->update() in the following iterations of update()
+    _connectTimeoutTs = millis() + MQTT_CONNECT_TIMEOUT;
+    _reconnectState = MqttReconnectState::Connecting;
+}
+
+void Network::scheduleReconnect()
+{
+    // Random delay between half and the full backoff, spreads the reconnects of many hubs
+    unsigned long waitTime = _reconnectBackoff / 2 + random(_reconnectBackoff / 2 + 1);
+    _nextReconnect = millis() + waitTime;
+    _reconnectBackoff = std::min(_reconnectBackoff * 2, (unsigned long)MQTT_RECONNECT_BACKOFF_MAX);
+
+    Log->print(F("MQTT: Next connection attempt in "));
+    Log->print(waitTime);
+    Log->println(F(" ms"));
+}
+
+void Network::onMqttConnected()
+{
+    Log->println(F("MQTT connected"));
+    eventLog->record(EventId::MqttConnected);
+    _mqttConnectionState = 1;
+    delay(100);
+
+    // With a resumed session the broker still has the subscriptions and the retained state of the previous connection.
+    // After a restart of Nuki Hub the topics may have changed, so the first connection always subscribes.
+    const bool sessionResumed = _sessionPresent && !_firstConnect;
+    if(sessionResumed)
+    {
+        Log->println(F("MQTT session resumed, skipping subscriptions"));
+    }
+
+    _ignoreSubscriptionsTs = millis() + 2000;
+    _device->mqttOnMessage(Network::onMqttDataReceivedCallback);
+    if(!sessionResumed)
+    {
+        subscribeAll();
+    }
+    if(_firstConnect)
+    {
+        _firstConnect = false;
+        publishString(_maintenancePathPrefix, mqtt_topic_network_device, _device->deviceName().c_str());
+        for(const auto& it : _initTopics)
         {
-            delay(50);
-            _device->update();
-            if(_keepAliveCallback != nullptr)
-            {
-                _keepAliveCallback();
-            }
+            _device->mqttPublish(it.first.c_str(), MQTT_QOS_LEVEL, true, it.second.c_str());
         }
+    }
+
+    publishString(_maintenancePathPrefix, mqtt_topic_mqtt_connection_state, "online");
+    publishString(_maintenancePathPrefix, mqtt_topic_info_nuki_hub_ip, _device->localIP().c_str());
+
+    // Clients may have missed presence events while disconnected, start again from the complete list
+    if(_presenceSnapshot != nullptr)
+    {
+        _presenceSnapshot->requestRefresh();
+    }
 
-        if (_device->mqttConnected())
+    _mqttConnectionState = 2;
+    if(!sessionResumed)
+    {
+        for(const auto& callback : _reconnectedCallbacks)
         {
-            Log->println(F("MQTT connected"));
-            _mqttConnectionState = 1;
-            delay(100);
+            callback();
+        }
+    }
+}
 
-            _ignoreSubscriptionsTs = millis() + 2000;
-            _device->mqttOnMessage(Network::onMqttDataReceivedCallback);
-            for(const String& topic : _subscribedTopics)
-            {
-                _device->mqttSubscribe(topic.c_str(), MQTT_QOS_LEVEL);
-            }
-            if(_firstConnect)
-            {
-                _firstConnect = false;
-                publishString(_maintenancePathPrefix, mqtt_topic_network_device, _device->deviceName().c_str());
-                for(const auto& it : _initTopics)
-                {
-                    _device->mqttPublish(it.first.c_str(), MQTT_QOS_LEVEL, true, it.second.c_str());
-                }
-            }
+void Network::subscribeAll()
+{
+    // Few SUBSCRIBE packets, sent back to back without waiting for the SUBACKs
+    espMqttClientTypes::SubscribeItem list[EMC_MAX_SUBSCRIBE_TOPICS];
+    size_t count = 0;
 
-            publishString(_maintenancePathPrefix, mqtt_topic_mqtt_connection_state, "online");
-            publishString(_maintenancePathPrefix, mqtt_topic_info_nuki_hub_ip, _device->localIP().c_str());
+    for(const String& topic : _subscribedTopics)
+    {
+        list[count].topic = topic.c_str();
+        list[count].qos = MQTT_QOS_LEVEL;
+        count++;
 
-            _mqttConnectionState = 2;
-            for(const auto& callback : _reconnectedCallbacks)
-            {
-                callback();
-            }
-        }
-        else
+        if(count == EMC_MAX_SUBSCRIBE_TOPICS)
         {
-            Log->print(F("MQTT connect failed, rc="));
-            _device->printError();
-            _mqttConnectionState = 0;
-            _nextReconnect = millis() + 5000;
-            _device->mqttDisconnect(true);
+            _device->mqttSubscribe(list, count);
+            count = 0;
         }
     }
-    return _mqttConnectionState > 0;
+
+    if(count > 0)
+    {
+        _device->mqttSubscribe(list, count);
+    }
 }
 
 void Network::subscribe(const char* prefix, const char *path)
@@ -559,6 +689,17 @@ void Network::initTopic(const char *prefix, const char *path, const char *value)
     _initTopics[pathStr] = valueStr;
 }
 
+void Network::addTopicAlias(const char *prefix, const char *path)
+{
+    char prefixedPath[500];
+    buildMqttPath(prefixedPath, { prefix, path });
+    if(!_device->mqttAddTopicAlias(prefixedPath))
+    {
+        Log->print(F("Topic alias not added: "));
+        Log->println(prefixedPath);
+    }
+}
+
 void Network::buildMqttPath(char* outPath, std::initializer_list<const char*> paths)
 {
     int offset = 0;
@@ -592,15 +733,27 @@ void Network::registerMqttReceiver(MqttReceiver* receiver)
 
 void Network::onMqttDataReceivedCallback(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
 {
-    uint8_t value[50] = {0};
-    size_t l = min(len, sizeof(value)-1);
+    // Messages that are complete in the receive buffer arrive in one call, others in chunks.
+    // Assemble them into a null terminated string, the receivers treat the payload as one.
+    if(total > MQTT_MAX_INCOMING_PAYLOAD)
+    {
+        if(index == 0)
+        {
+            Log->print(F("MQTT message too large, ignored: "));
+            Log->println(topic);
+        }
+        return;
+    }
 
-    for(int i=0; i<l; i++)
+    memcpy(&_inst->_mqttPayload[index], payload, len);
+    if(index + len < total)
     {
-        value[i] = payload[i];
+        return;
     }
+    _inst->_mqttPayload[total] = 0x00;
 
-    _inst->onMqttDataReceived(properties, topic, value, len, index, total);
+    size_t start = 0;
+    _inst->onMqttDataReceived(properties, topic, (const uint8_t*)_inst->_mqttPayload, total, start, total);
 }
 
 void Network::onMqttDataReceived(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t& len, size_t& index, size_t& total)
@@ -612,9 +765,34 @@ void Network::onMqttDataReceived(const espMqttClientTypes::MessageProperties& pr
         return;
     }
 
+    char presenceRefreshPath[250];
+    buildMqttPath(presenceRefreshPath, {_mqttPresencePrefix, mqtt_topic_presence_refresh});
+    if(strcmp(topic, presenceRefreshPath) == 0)
+    {
+        if(len == 1 && payload[0] == '1' && _presenceSnapshot != nullptr)
+        {
+            Log->println(F("Presence list refresh requested"));
+            _presenceSnapshot->requestRefresh();
+            publishString(_mqttPresencePrefix, mqtt_topic_presence_refresh, "0");
+        }
+        return;
+    }
+
+    char eventLogExportPath[250];
+    buildMqttPath(eventLogExportPath, {_maintenancePathPrefix, mqtt_topic_event_log_export});
+    if(strcmp(topic, eventLogExportPath) == 0)
+    {
+        if(len == 1 && payload[0] == '1')
+        {
+            _eventLogExportRequested = true;
+            publishString(_maintenancePathPrefix, mqtt_topic_event_log_export, "0");
+        }
+        return;
+    }
+
     for(auto receiver : _mqttReceivers)
     {
-        receiver->onMqttDataReceived(topic, (byte*)payload, index);
+        receiver->onMqttDataReceived(topic, (byte*)payload, len);
     }
 }
 
@@ -651,7 +829,71 @@ void Network::parseGpioTopics(const espMqttClientTypes::MessageProperties &prope
 
 void Network::gpioActionCallback(const GpioAction &action, const int &pin)
 {
-    _gpioTs[pin] = millis();
+    if(action != GpioAction::GeneralInput || pin < 0 || pin >= GPIO_NR_OF_PINS)
+    {
+        return;
+    }
+    _gpioPendingMask |= (1ULL << pin);
+}
+
+void Network::publishGpioStates()
+{
+    char gpioPath[250];
+
+    for(uint8_t pin = 0; pin < GPIO_NR_OF_PINS; pin++)
+    {
+        if((_gpioPendingMask & (1ULL << pin)) == 0)
+        {
+            continue;
+        }
+
+        // Publish once the input has settled, bounces after the accepted edge are still tracked as edges
+        if((millis() - _gpio->getLastEdgeTs(pin)) < GPIO_DEBOUNCE_TIME)
+        {
+            continue;
+        }
+
+        _gpioPendingMask &= ~(1ULL << pin);
+
+        uint8_t pinState = digitalRead(pin) == HIGH ? 1 : 0;
+        buildMqttPath(gpioPath, {mqtt_topic_gpio_prefix, (mqtt_topic_gpio_pin + std::to_string(pin)).c_str(), mqtt_topic_gpio_state});
+        publishInt(_lockPath.c_str(), gpioPath, pinState);
+
+        Log->print(F("GPIO "));
+        Log->print(pin);
+        Log->print(F(" (Input) --> "));
+        Log->println(pinState);
+    }
+}
+
+void Network::publishGpioStatistics()
+{
+    char gpioPath[250];
+
+    for(const auto& entry : _gpio->pinConfiguration())
+    {
+        if(!Gpio::isInput(entry.role) || entry.pin >= GPIO_NR_OF_PINS)
+        {
+            continue;
+        }
+
+        uint32_t edgesSeen = 0;
+        uint32_t edgesSuppressed = 0;
+        _gpio->getEdgeStatistics(entry.pin, edgesSeen, edgesSuppressed);
+
+        if(_gpioStatisticsPublished && edgesSeen == _gpioPublishedEdges[entry.pin])
+        {
+            continue;
+        }
+        _gpioPublishedEdges[entry.pin] = edgesSeen;
+
+        buildMqttPath(gpioPath, {mqtt_topic_gpio_prefix, (mqtt_topic_gpio_pin + std::to_string(entry.pin)).c_str(), mqtt_topic_gpio_edges_seen});
+        publishUInt(_lockPath.c_str(), gpioPath, edgesSeen);
+        buildMqttPath(gpioPath, {mqtt_topic_gpio_prefix, (mqtt_topic_gpio_pin + std::to_string(entry.pin)).c_str(), mqtt_topic_gpio_edges_suppressed});
+        publishUInt(_lockPath.c_str(), gpioPath, edgesSuppressed);
+    }
+
+    _gpioStatisticsPublished = true;
 }
 
 void Network::reconfigureDevice()
@@ -663,6 +905,12 @@ void Network::setMqttPresencePath(char *path)
 {
     memset(_mqttPresencePrefix, 0, sizeof(_mqttPresencePrefix));
     strcpy(_mqttPresencePrefix, path);
+
+    initTopic(_mqttPresencePrefix, mqtt_topic_presence_refresh, "0");
+    subscribe(_mqttPresencePrefix, mqtt_topic_presence_refresh);
+
+    addTopicAlias(_mqttPresencePrefix, mqtt_topic_presence);
+    addTopicAlias(_mqttPresencePrefix, mqtt_topic_presence_events);
 }
 
 void Network::disableAutoRestarts()
@@ -1541,9 +1789,158 @@ DynamicJsonDocument Network::createHassJson(const String& uidString,
     return json;
 }
 
-void Network::publishPresenceDetection(char *csv)
+void Network::setPresenceSnapshot(PresenceSnapshot *snapshot, PresenceSnapshot* eventSnapshot)
+{
+    _presenceSnapshot = snapshot;
+    _presenceEventSnapshot = eventSnapshot;
+}
+
+void Network::publishPresence()
 {
-    _presenceCsv = csv;
+    uint32_t presenceSequence = 0;
+
+    if(_presenceSnapshot != nullptr)
+    {
+        const char* presenceCsv = _presenceSnapshot->acquire(presenceSequence);
+        if(presenceCsv != nullptr)
+        {
+            bool success = strlen(presenceCsv) == 0 || publishString(_mqttPresencePrefix, mqtt_topic_presence, presenceCsv);
+            if(!success)
+            {
+                Log->println(F("Failed to publish presence CSV data."));
+                Log->println(presenceCsv);
+            }
+            _presenceSnapshot->release(presenceSequence);
+        }
+    }
+
+    if(_presenceEventSnapshot != nullptr)
+    {
+        const char* presenceEvents = _presenceEventSnapshot->acquire(presenceSequence);
+        if(presenceEvents != nullptr)
+        {
+            // Events describe a change, not a state, don't retain them
+            char path[200] = {0};
+            buildMqttPath(path, { _mqttPresencePrefix, mqtt_topic_presence_events });
+            // Stale events are useless to a client that connects later, let the broker drop them (MQTT 5 only)
+            if(strlen(presenceEvents) > 0 && _device->mqttPublish(path, MQTT_QOS_LEVEL, false, presenceEvents, MQTT_PRESENCE_EVENTS_EXPIRY) == 0)
+            {
+                // Keep the batch, presence detection doesn't write new events until it has been published
+                Log->println(F("Failed to publish presence events."));
+            }
+            else
+            {
+                _presenceEventSnapshot->release(presenceSequence);
+            }
+        }
+    }
+}
+
+void Network::publishEventLog()
+{
+    _eventLogExportRequested = false;
+
+    const uint32_t recordCount = eventLog->recordCount();
+    uint32_t cursor = recordCount > EVENT_LOG_EXPORT_RECORDS ? recordCount - EVENT_LOG_EXPORT_RECORDS : 0;
+    EventLogRecord records[8];
+    size_t count;
+    size_t offset = 0;
+
+    while(offset + EVENT_LOG_TEXT_LENGTH < _bufferSize && (count = eventLog->read(cursor, records, 8)) > 0)
+    {
+        for(size_t i = 0; i < count && offset + EVENT_LOG_TEXT_LENGTH < _bufferSize; i++)
+        {
+            offset += EventLog::format(records[i], _buffer + offset, _bufferSize - offset);
+        }
+    }
+    _buffer[offset] = 0x00;
+
+    // A snapshot on request, don't retain it
+    char path[200] = {0};
+    buildMqttPath(path, { _maintenancePathPrefix, mqtt_topic_event_log });
+    if(_device->mqttPublish(path, MQTT_QOS_LEVEL, false, _buffer) == 0)
+    {
+        Log->println(F("Failed to publish event log."));
+    }
+}
+
+void Network::publishTelemetry()
+{
+    _telemetry.sample();
+
+    const HeapTelemetry heap = _telemetry.heap();
+    DynamicJsonDocument json(JSON_BUFFER_SIZE);
+    json["free"] = heap.freeHeap;
+    json["minFree"] = heap.minFreeHeap;
+    json["largestBlock"] = heap.largestFreeBlock;
+    json["fragmentation"] = heap.fragmentation;
+    serializeJson(json, _buffer, _bufferSize);
+    publishString(_maintenancePathPrefix, mqtt_topic_heap, _buffer);
+
+    const size_t count = _telemetry.tasks(_telemetryTasks, TELEMETRY_MAX_TASKS);
+    DynamicJsonDocument tasksJson(TELEMETRY_JSON_SIZE);
+    char key[configMAX_TASK_NAME_LEN + 12];
+    for(size_t i = 0; i < count; i++)
+    {
+        // Task names aren't unique, e.g. there is an IDLE task per core
+        snprintf(key, sizeof(key), "%s#%u", _telemetryTasks[i].name, (unsigned int)_telemetryTasks[i].number);
+        JsonObject task = tasksJson.createNestedObject(key);
+        task["stack"] = _telemetryTasks[i].stackHighWaterMark;
+        if(_telemetryTasks[i].cpuLoad >= 0)
+        {
+            task["cpu"] = _telemetryTasks[i].cpuLoad;
+        }
+    }
+    serializeJson(tasksJson, _buffer, _bufferSize);
+    publishString(_maintenancePathPrefix, mqtt_topic_tasks, _buffer);
+
+    publishLoopTiming();
+}
+
+void Network::publishLoopTiming()
+{
+    DynamicJsonDocument json(LOOP_TIMING_JSON_SIZE);
+    for(int id = 0; id < (int)TimingId::Count; id++)
+    {
+        TimingHistogram& histogram = loopTiming((TimingId)id);
+        if(histogram.count() == 0)
+        {
+            continue;
+        }
+
+        JsonObject timing = json.createNestedObject(timingName((TimingId)id));
+        timing["count"] = histogram.count();
+        timing["max"] = histogram.takeMax();
+
+        // Trailing empty buckets are left out
+        int lastBucket = LOOP_TIMING_BUCKETS - 1;
+        while(lastBucket > 0 && histogram.bucket(lastBucket) == 0)
+        {
+            --lastBucket;
+        }
+        JsonArray buckets = timing.createNestedArray("buckets");
+        for(int i = 0; i <= lastBucket; i++)
+        {
+            buckets.add(histogram.bucket(i));
+        }
+    }
+    serializeJson(json, _buffer, _bufferSize);
+    publishString(_maintenancePathPrefix, mqtt_topic_loop_timing, _buffer);
+}
+
+Telemetry* Network::telemetry()
+{
+    return &_telemetry;
+}
+
+void Network::publishOtaState(const char* state)
+{
+    publishString(_maintenancePathPrefix, mqtt_topic_ota_state, state);
+}
+
+void Network::publishOtaProgress(const unsigned long bytesWritten)
+{
+    publishULong(_maintenancePathPrefix, mqtt_topic_ota_progress, bytesWritten);
 }
 
 const NetworkDeviceType Network::networkDeviceType()
@@ -1556,11 +1953,6 @@ uint16_t Network::subscribe(const char *topic, uint8_t qos)
     return _device->mqttSubscribe(topic, qos);
 }
 
-void Network::setKeepAliveCallback(std::function<void()> reconnectTick)
-{
-    _keepAliveCallback = reconnectTick;
-}
-
 void Network::addReconnectedCallback(std::function<void()> reconnectedCallback)
 {
     _reconnectedCallbacks.push_back(reconnectedCallback);
@@ -8,9 +8,19 @@
 #include "networkDevices/IPConfiguration.h"
 #include "MqttTopics.h"
 #include "Gpio.h"
+#include "PresenceSnapshot.h"
+#include "Telemetry.h"
+#include "LoopTiming.h"
+#include "Config.h"
 #include <ArduinoJson.h>
 #include <HTTPClient.h>
 
+enum class MqttReconnectState
+{
+    Waiting,
+    Connecting
+};
+
 enum class NetworkDeviceType
 {
     WiFi,
@@ -22,6 +32,8 @@ enum class NetworkDeviceType
 };
 
 #define JSON_BUFFER_SIZE 1024
+#define GPIO_STATISTICS_PUBLISH_INTERVAL 60000
+#define EVENT_LOG_EXPORT_RECORDS 80
 
 class Network
 {
@@ -38,6 +50,7 @@ public:
 
     void subscribe(const char* prefix, const char* path);
     void initTopic(const char* prefix, const char* path, const char* value);
+    void addTopicAlias(const char* prefix, const char* path);
     void publishFloat(const char* prefix, const char* topic, const float value, const uint8_t precision = 2);
     void publishInt(const char* prefix, const char* topic, const int value);
     void publishUInt(const char* prefix, const char* topic, const unsigned int value);
@@ -62,7 +75,9 @@ public:
 
     void clearWifiFallback();
 
-    void publishPresenceDetection(char* csv);
+    void setPresenceSnapshot(PresenceSnapshot* snapshot, PresenceSnapshot* eventSnapshot);
+    void publishOtaState(const char* state);
+    void publishOtaProgress(const unsigned long bytesWritten);
 
     int mqttConnectionState(); // 0 = not connected; 1 = connected; 2 = connected and mqtt processed
     bool encryptionSupported();
@@ -72,18 +87,30 @@ public:
 
     uint16_t subscribe(const char* topic, uint8_t qos);
 
-    void setKeepAliveCallback(std::function<void()> reconnectTick);
     void addReconnectedCallback(std::function<void()> reconnectedCallback);
 
     NetworkDevice* device();
+    Telemetry* telemetry();
 
 private:
     static void onMqttDataReceivedCallback(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total);
     void onMqttDataReceived(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t& len, size_t& index, size_t& total);
     void parseGpioTopics(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t& len, size_t& index, size_t& total);
     void gpioActionCallback(const GpioAction& action, const int& pin);
+    void publishPresence();
+    void publishGpioStates();
+    void publishGpioStatistics();
+    void publishEventLog();
+    void publishTelemetry();
+    void publishLoopTiming();
     void setupDevice();
     bool reconnect();
+    void startMqttConnect();
+    void scheduleReconnect();
+    void onMqttConnected();
+    void subscribeAll();
+    static void updateCheckTask(void* param);
+    void checkLatestVersion();
 
     void publishHassTopic(const String& mqttDeviceType,
                           const String& mqttDeviceName,
@@ -128,8 +155,10 @@ private:
     char _mqttConnectionStateTopic[211] = {0};
     String _lockPath;
 
-    const char* _latestVersion;
-    HTTPClient https;
+    String _updateCheckUrl;
+    TaskHandle_t _updateCheckTaskHandle = nullptr;
+    char _latestVersion[33] = {0};
+    volatile bool _latestVersionReceived = false;
 
     Preferences* _preferences;
     Gpio* _gpio;
@@ -139,8 +168,12 @@ private:
     NetworkDevice* _device = nullptr;
     int _mqttConnectionState = 0;
     bool _connectReplyReceived = false;
+    bool _sessionPresent = false;
 
+    MqttReconnectState _reconnectState = MqttReconnectState::Waiting;
     unsigned long _nextReconnect = 0;
+    unsigned long _connectTimeoutTs = 0;
+    unsigned long _reconnectBackoff = MQTT_RECONNECT_BACKOFF_MIN;
     char _mqttBrokerAddr[101] = {0};
     char _mqttUser[31] = {0};
     char _mqttPass[31] = {0};
@@ -148,26 +181,36 @@ private:
     char _maintenancePathPrefix[181] = {0};
     int _networkTimeout = 0;
     std::vector<MqttReceiver*> _mqttReceivers;
-    char* _presenceCsv = nullptr;
+    PresenceSnapshot* _presenceSnapshot = nullptr;
+    PresenceSnapshot* _presenceEventSnapshot = nullptr;
     bool _restartOnDisconnect = false;
     bool _firstConnect = true;
     bool _publishDebugInfo = false;
+    bool _eventLogExportRequested = false;
     std::vector<String> _subscribedTopics;
     std::map<String, String> _initTopics;
 
     unsigned long _lastConnectedTs = 0;
     unsigned long _lastMaintenanceTs = 0;
+    unsigned long _lastTelemetryTs = 0;
+    Telemetry _telemetry;
+    TaskTelemetry _telemetryTasks[TELEMETRY_MAX_TASKS];
     unsigned long _lastUpdateCheckTs = 0;
     unsigned long _lastRssiTs = 0;
     bool _mqttEnabled = true;
+    bool _mqttV5 = false;
+    char _mqttPayload[MQTT_MAX_INCOMING_PAYLOAD + 1] = {0};
     static unsigned long _ignoreSubscriptionsTs;
     long _rssiPublishInterval = 0;
-    std::map<uint8_t, unsigned long> _gpioTs;
+    uint64_t _gpioPendingMask = 0;
+    uint32_t _gpioPublishedEdges[GPIO_NR_OF_PINS] = {0};
+    unsigned long _lastGpioStatisticsTs = 0;
+    bool _gpioStatisticsPublished = false;
+    int _gpioSubscriberId = -1;
 
     char* _buffer;
     const size_t _bufferSize;
 
-    std::function<void()> _keepAliveCallback = nullptr;
     std::vector<std::function<void()>> _reconnectedCallbacks;
 
     NetworkDeviceType _networkDeviceType  = (NetworkDeviceType)-1;
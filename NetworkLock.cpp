@@ -59,6 +59,16 @@ void NetworkLock::initialize()
     _network->subscribe(_mqttPath, mqtt_topic_reset);
     _network->initTopic(_mqttPath, mqtt_topic_reset, "0");
 
+    // Published on every state change, sent with a topic alias when connected with MQTT 5
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_state);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_binary_state);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_ha_state);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_json);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_rssi);
+
+    _network->subscribe(_mqttPath, mqtt_topic_ota_update);
+    _network->initTopic(_mqttPath, mqtt_topic_ota_update, "0");
+
     _network->initTopic(_mqttPath, mqtt_topic_query_config, "0");
     _network->initTopic(_mqttPath, mqtt_topic_query_lockstate, "0");
     _network->initTopic(_mqttPath, mqtt_topic_query_battery, "0");
@@ -100,6 +110,16 @@ void NetworkLock::onMqttDataReceived(const char* topic, byte* payload, const uns
         restartEsp(RestartReason::RequestedViaMqtt);
     }
 
+    if(comparePrefixedPath(topic, mqtt_topic_ota_update) && strcmp(value, "1") == 0)
+    {
+        Log->println(F("OTA update requested via MQTT."));
+        publishString(mqtt_topic_ota_update, "0");
+        if(_otaUpdateReceivedCallback != nullptr)
+        {
+            _otaUpdateReceivedCallback();
+        }
+    }
+
     if(comparePrefixedPath(topic, mqtt_topic_lock_action))
     {
         if(strcmp(value, "") == 0 ||
@@ -550,6 +570,11 @@ void NetworkLock::setConfigUpdateReceivedCallback(void (*configUpdateReceivedCal
     _configUpdateReceivedCallback = configUpdateReceivedCallback;
 }
 
+void NetworkLock::setOtaUpdateReceivedCallback(void (*otaUpdateReceivedCallback)())
+{
+    _otaUpdateReceivedCallback = otaUpdateReceivedCallback;
+}
+
 void NetworkLock::setKeypadCommandReceivedCallback(void (*keypadCommandReceivedReceivedCallback)(const char* command, const uint& id, const String& name, const String& code, const int& enabled))
 {
     _keypadCommandReceivedReceivedCallback = keypadCommandReceivedReceivedCallback;
@@ -42,6 +42,7 @@ public:
     void setLockActionReceivedCallback(LockActionResult (*lockActionReceivedCallback)(const char* value));
     void setConfigUpdateReceivedCallback(void (*configUpdateReceivedCallback)(const char* path, const char* value));
     void setKeypadCommandReceivedCallback(void (*keypadCommandReceivedReceivedCallback)(const char* command, const uint& id, const String& name, const String& code, const int& enabled));
+    void setOtaUpdateReceivedCallback(void (*otaUpdateReceivedCallback)());
 
     void onMqttDataReceived(const char* topic, byte* payload, const unsigned int length) override;
 
@@ -90,4 +91,5 @@ private:
     LockActionResult (*_lockActionReceivedCallback)(const char* value) = nullptr;
     void (*_configUpdateReceivedCallback)(const char* path, const char* value) = nullptr;
     void (*_keypadCommandReceivedReceivedCallback)(const char* command, const uint& id, const String& name, const String& code, const int& enabled) = nullptr;
+    void (*_otaUpdateReceivedCallback)() = nullptr;
 };
@@ -46,6 +46,12 @@ void NetworkOpener::initialize()
         _network->subscribe(_mqttPath, topic);
     }
 
+    // Published on every state change, sent with a topic alias when connected with MQTT 5
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_state);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_binary_state);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_ha_state);
+    _network->addTopicAlias(_mqttPath, mqtt_topic_lock_json);
+
     _network->initTopic(_mqttPath, mqtt_topic_query_config, "0");
     _network->initTopic(_mqttPath, mqtt_topic_query_lockstate, "0");
     _network->initTopic(_mqttPath, mqtt_topic_query_battery, "0");
@@ -4,6 +4,8 @@
 #include "MqttTopics.h"
 #include "Logger.h"
 #include "RestartReason.h"
+#include "Config.h"
+#include "EventLog.h"
 #include <NukiOpenerUtils.h>
 
 NukiOpenerWrapper* nukiOpenerInst;
@@ -33,7 +35,7 @@ NukiOpenerWrapper::NukiOpenerWrapper(const std::string& deviceName, NukiDeviceId
     network->setConfigUpdateReceivedCallback(nukiOpenerInst->onConfigUpdateReceivedCallback);
     network->setKeypadCommandReceivedCallback(nukiOpenerInst->onKeypadCommandReceivedCallback);
 
-    _gpio->addCallback(NukiOpenerWrapper::gpioActionCallback);
+    _gpioSubscriberId = _gpio->addCallback(NukiOpenerWrapper::gpioActionCallback);
 }
 
 
@@ -132,6 +134,11 @@ void NukiOpenerWrapper::update()
             Log->println(F("Nuki opener paired"));
             _paired = true;
             _network->publishBleAddress(_nukiOpener.getBleAddress().toString());
+
+            // Only the advertisements of the paired opener are needed from now on
+            BleScanner::Filter filter;
+            filter.addresses.push_back(_nukiOpener.getBleAddress());
+            _bleScanner->setFilter(&_nukiOpener, filter);
         }
         else
         {
@@ -140,6 +147,8 @@ void NukiOpenerWrapper::update()
         }
     }
 
+    _gpio->processEvents(_gpioSubscriberId);
+
     unsigned long ts = millis();
     unsigned long lastReceivedBeaconTs = _nukiOpener.getLastReceivedBeaconTs();
     uint8_t queryCommands = _network->queryCommands();
@@ -201,9 +210,16 @@ void NukiOpenerWrapper::update()
         updateKeypad();
     }
 
+    if(_nextLockAction != (NukiOpener::LockAction)0xff)
+    {
+        // keep listening closely for beacons until the device reports the new state
+        _bleScanner->requestHighDuty(BLE_SCAN_COMMAND_HIGH_DUTY_TIME);
+    }
+
     if(_nextLockAction != (NukiOpener::LockAction)0xff && ts > _nextRetryTs)
     {
         Nuki::CmdResult cmdResult = _nukiOpener.lockAction(_nextLockAction, 0, 0);
+        eventLog->record(EventId::OpenerCommandResult, (uint32_t)cmdResult | ((uint32_t)_nextLockAction << 8));
 
         char resultStr[15] = {0};
         NukiOpener::cmdResultToString(cmdResult, resultStr);
@@ -235,6 +251,7 @@ void NukiOpenerWrapper::update()
                 Log->println(_nrOfRetries);
 
                 _network->publishRetry(std::to_string(_retryCount + 1));
+                eventLog->record(EventId::OpenerCommandRetry, _retryCount + 1);
 
                 _nextRetryTs = millis() + _retryDelay;
 
@@ -244,6 +261,7 @@ void NukiOpenerWrapper::update()
             {
                 Log->println(F("Opener: Maximum number of retries exceeded, aborting."));
                 _network->publishRetry("failed");
+                eventLog->record(EventId::OpenerCommandRetry, 0);
                 _retryCount = 0;
                 _nextRetryTs = 0;
                 _nextLockAction = (NukiOpener::LockAction) 0xff;
@@ -316,6 +334,7 @@ void NukiOpenerWrapper::unpair()
     _nukiOpener.unPairNuki();
     _deviceId->assignNewId();
     _paired = false;
+    _bleScanner->setFilter(&_nukiOpener, BleScanner::Filter());
 }
 
 void NukiOpenerWrapper::updateKeyTurnerState()
@@ -816,26 +835,15 @@ void NukiOpenerWrapper::updateGpioOutputs()
 {
     using namespace NukiOpener;
 
-    const auto& pinConfiguration = _gpio->pinConfiguration();
-
-    const LockState& lockState = _keyTurnerState.lockState;
-
     bool rtoActive = _keyTurnerState.lockState == LockState::RTOactive;
     bool cmActive = _keyTurnerState.nukiState == State::ContinuousMode;
 
-    for(const auto& entry : pinConfiguration)
-    {
-        switch(entry.role)
-        {
-            case PinRole::OutputHighRtoActive:
-                _gpio->setPinOutput(entry.pin, rtoActive ? HIGH : LOW);
-                break;
-            case PinRole::OutputHighCmActive:
-                _gpio->setPinOutput(entry.pin, cmActive ? HIGH : LOW);
-                break;
-            case PinRole::OutputHighRtoOrCmActive:
-                _gpio->setPinOutput(entry.pin, rtoActive || cmActive ? HIGH : LOW);
-                break;
-        }
-    }
-}
\ No newline at end of file
+    const uint64_t rtoMask = _gpio->getOutputMask(PinRole::OutputHighRtoActive);
+    const uint64_t cmMask = _gpio->getOutputMask(PinRole::OutputHighCmActive);
+    const uint64_t rtoOrCmMask = _gpio->getOutputMask(PinRole::OutputHighRtoOrCmActive);
+
+    const uint64_t highMask = (rtoActive ? rtoMask : 0) | (cmActive ? cmMask : 0) | (rtoActive || cmActive ? rtoOrCmMask : 0);
+    const uint64_t lowMask = (rtoMask | cmMask | rtoOrCmMask) & ~highMask;
+
+    _gpio->setOutputs(highMask, lowMask);
+}
@@ -78,6 +78,7 @@ private:
     BleScanner::Scanner* _bleScanner = nullptr;
     NetworkOpener* _network = nullptr;
     Gpio* _gpio = nullptr;
+    int _gpioSubscriberId = -1;
     Preferences* _preferences = nullptr;
     int _intervalLockstate = 0; // seconds
     int _intervalBattery = 0; // seconds
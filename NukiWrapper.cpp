@@ -4,6 +4,8 @@
 #include "MqttTopics.h"
 #include "Logger.h"
 #include "RestartReason.h"
+#include "Config.h"
+#include "EventLog.h"
 #include <NukiLockUtils.h>
 
 NukiWrapper* nukiInst;
@@ -33,7 +35,7 @@ NukiWrapper::NukiWrapper(const std::string& deviceName, NukiDeviceId* deviceId,
     network->setConfigUpdateReceivedCallback(nukiInst->onConfigUpdateReceivedCallback);
     network->setKeypadCommandReceivedCallback(nukiInst->onKeypadCommandReceivedCallback);
 
-    _gpio->addCallback(NukiWrapper::gpioActionCallback);
+    _gpioSubscriberId = _gpio->addCallback(NukiWrapper::gpioActionCallback);
 }
 
 
@@ -133,6 +135,11 @@ void NukiWrapper::update()
             Log->println(F("Nuki paired"));
             _paired = true;
             _network->publishBleAddress(_nukiLock.getBleAddress().toString());
+
+            // Only the advertisements of the paired lock are needed from now on
+            BleScanner::Filter filter;
+            filter.addresses.push_back(_nukiLock.getBleAddress());
+            _bleScanner->setFilter(&_nukiLock, filter);
         }
         else
         {
@@ -141,6 +148,8 @@ void NukiWrapper::update()
         }
     }
 
+    _gpio->processEvents(_gpioSubscriberId);
+
     unsigned long ts = millis();
     unsigned long lastReceivedBeaconTs = _nukiLock.getLastReceivedBeaconTs();
     uint8_t queryCommands = _network->queryCommands();
@@ -202,9 +211,16 @@ void NukiWrapper::update()
         updateKeypad();
     }
 
+    if(_nextLockAction != (NukiLock::LockAction)0xff)
+    {
+        // keep listening closely for beacons until the device reports the new state
+        _bleScanner->requestHighDuty(BLE_SCAN_COMMAND_HIGH_DUTY_TIME);
+    }
+
     if(_nextLockAction != (NukiLock::LockAction)0xff && ts > _nextRetryTs)
     {
         Nuki::CmdResult cmdResult = _nukiLock.lockAction(_nextLockAction, 0, 0);
+        eventLog->record(EventId::LockCommandResult, (uint32_t)cmdResult | ((uint32_t)_nextLockAction << 8));
 
         char resultStr[15] = {0};
         NukiLock::cmdResultToString(cmdResult, resultStr);
@@ -236,6 +252,7 @@ void NukiWrapper::update()
                 Log->println(_nrOfRetries);
 
                 _network->publishRetry(std::to_string(_retryCount + 1));
+                eventLog->record(EventId::LockCommandRetry, _retryCount + 1);
 
                 _nextRetryTs = millis() + _retryDelay;
 
@@ -245,6 +262,7 @@ void NukiWrapper::update()
             {
                 Log->println(F("Lock: Maximum number of retries exceeded, aborting."));
                 _network->publishRetry("failed");
+                eventLog->record(EventId::LockCommandRetry, 0);
                 _retryCount = 0;
                 _nextRetryTs = 0;
                 _nextLockAction = (NukiLock::LockAction) 0xff;
@@ -302,6 +320,7 @@ void NukiWrapper::unpair()
     _nukiLock.unPairNuki();
     _deviceId->assignNewId();
     _paired = false;
+    _bleScanner->setFilter(&_nukiLock, BleScanner::Filter());
 }
 
 void NukiWrapper::updateKeyTurnerState()
@@ -805,24 +824,17 @@ void NukiWrapper::updateGpioOutputs()
 {
     using namespace NukiLock;
 
-    const auto& pinConfiguration = _gpio->pinConfiguration();
-
     const LockState& lockState = _keyTurnerState.lockState;
 
-    for(const auto& entry : pinConfiguration)
-    {
-        switch(entry.role)
-        {
-            case PinRole::OutputHighLocked:
-                _gpio->setPinOutput(entry.pin, lockState == LockState::Locked || lockState == LockState::Locking ? HIGH : LOW);
-                break;
-            case PinRole::OutputHighUnlocked:
-                _gpio->setPinOutput(entry.pin, lockState == LockState::Locked || lockState == LockState::Locking ? LOW : HIGH);
-                break;
-            case PinRole::OutputHighMotorBlocked:
-                _gpio->setPinOutput(entry.pin, lockState == LockState::MotorBlocked  ? HIGH : LOW);
-                break;
-        }
-    }
-}
+    const bool locked = lockState == LockState::Locked || lockState == LockState::Locking;
+    const bool motorBlocked = lockState == LockState::MotorBlocked;
 
+    const uint64_t lockedMask = _gpio->getOutputMask(PinRole::OutputHighLocked);
+    const uint64_t unlockedMask = _gpio->getOutputMask(PinRole::OutputHighUnlocked);
+    const uint64_t motorBlockedMask = _gpio->getOutputMask(PinRole::OutputHighMotorBlocked);
+
+    const uint64_t highMask = (locked ? lockedMask : unlockedMask) | (motorBlocked ? motorBlockedMask : 0);
+    const uint64_t lowMask = (lockedMask | unlockedMask | motorBlockedMask) & ~highMask;
+
+    _gpio->setOutputs(highMask, lowMask);
+}
@@ -77,6 +77,7 @@ private:
     BleScanner::Scanner* _bleScanner = nullptr;
     NetworkLock* _network = nullptr;
     Gpio* _gpio = nullptr;
+    int _gpioSubscriberId = -1;
     Preferences* _preferences;
     int _intervalLockstate = 0; // seconds
     int _intervalBattery = 0; // seconds
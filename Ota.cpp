@@ -3,35 +3,233 @@
 #include "Logger.h"
 #include "RestartReason.h"
 
-#define FULL_PACKET 1436 // HTTP_UPLOAD_BUFLEN in WebServer,h
-
-void Ota::updateFirmware(uint8_t* buf, size_t size)
+bool Ota::begin(const char* expectedSha256)
 {
-    if(!_updateStarted && size == 0)
+    bool started = false;
+    if(!_updateStarted.compare_exchange_strong(started, true))
     {
-        Log->println("OTA upload cancelled, size is 0.");
-        return;
+        Log->println(F("OTA: Update already in progress."));
+        return false;
+    }
+
+    _updateCompleted = false;
+    _writeError = false;
+    _bytesWritten = 0;
+    _verifySha256 = false;
+
+    if(expectedSha256 != nullptr && strlen(expectedSha256) > 0)
+    {
+        if(strlen(expectedSha256) != OTA_SHA256_HEX_LENGTH)
+        {
+            Log->println(F("OTA: Invalid SHA-256 digest, expected 64 hex characters."));
+            _updateStarted = false;
+            return false;
+        }
+        for(int i=0; i < 32; i++)
+        {
+            char hex[3] = { expectedSha256[i * 2], expectedSha256[i * 2 + 1], 0 };
+            _expectedSha256[i] = strtoul(hex, nullptr, 16);
+        }
+        _verifySha256 = true;
+    }
+
+    _buffers[0] = (uint8_t*)malloc(OTA_BUFFER_SIZE);
+    _buffers[1] = (uint8_t*)malloc(OTA_BUFFER_SIZE);
+    _freeBuffers = xQueueCreate(2, sizeof(int));
+    _filledBuffers = xQueueCreate(2, sizeof(int));
+
+    if(_buffers[0] == nullptr || _buffers[1] == nullptr || _freeBuffers == nullptr || _filledBuffers == nullptr)
+    {
+        Log->println(F("OTA: Failed to allocate buffers."));
+        releaseBuffers();
+        _updateStarted = false;
+        return false;
     }
 
-    if (!_updateStarted)
-    { //If it's the first packet of OTA since bootup, begin OTA
-        Log->println("BeginOTA");
-        esp_ota_begin(esp_ota_get_next_update_partition(NULL), OTA_SIZE_UNKNOWN, &otaHandler);
-        _updateStarted = true;
+    Log->println("BeginOTA");
+    if(esp_ota_begin(esp_ota_get_next_update_partition(NULL), OTA_SIZE_UNKNOWN, &otaHandler) != ESP_OK)
+    {
+        Log->println(F("OTA: esp_ota_begin failed."));
+        releaseBuffers();
+        _updateStarted = false;
+        return false;
     }
-    esp_ota_write(otaHandler, buf, size);
-    if (size != FULL_PACKET)
+
+    mbedtls_sha256_init(&_sha256);
+    mbedtls_sha256_starts_ret(&_sha256, 0);
+
+    for(int i=0; i < 2; i++)
     {
-        esp_ota_end(otaHandler);
-        Log->println("EndOTA");
-        if (ESP_OK == esp_ota_set_boot_partition(esp_ota_get_next_update_partition(NULL)))
+        _bufferLength[i] = 0;
+        xQueueSend(_freeBuffers, &i, 0);
+    }
+    xQueueReceive(_freeBuffers, &_currentBuffer, portMAX_DELAY);
+
+    xTaskCreatePinnedToCore(writerTask, "otawr", 3072, this, 2, &_writerTaskHandle, 1);
+
+    return true;
+}
+
+bool Ota::write(const uint8_t* buf, size_t size)
+{
+    if(!_updateStarted || _writeError)
+    {
+        return false;
+    }
+
+    mbedtls_sha256_update_ret(&_sha256, buf, size);
+
+    size_t offset = 0;
+    while(offset < size)
+    {
+        size_t len = std::min(size - offset, (size_t)OTA_BUFFER_SIZE - _bufferLength[_currentBuffer]);
+        memcpy(_buffers[_currentBuffer] + _bufferLength[_currentBuffer], buf + offset, len);
+        _bufferLength[_currentBuffer] += len;
+        offset += len;
+
+        if(_bufferLength[_currentBuffer] == OTA_BUFFER_SIZE)
         {
-            _updateCompleted = true;
+            if(!submitBuffer())
+            {
+                return false;
+            }
         }
-        else
+    }
+
+    _bytesWritten += size;
+    return true;
+}
+
+bool Ota::end()
+{
+    if(!_updateStarted)
+    {
+        return false;
+    }
+
+    if(_bufferLength[_currentBuffer] > 0)
+    {
+        submitBuffer();
+    }
+    waitForWriter();
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish_ret(&_sha256, digest);
+    mbedtls_sha256_free(&_sha256);
+    releaseBuffers();
+
+    bool success = activate(digest);
+    otaHandler = 0;
+    _updateStarted = false;
+    return success;
+}
+
+bool Ota::activate(const uint8_t* digest)
+{
+    if(_writeError)
+    {
+        Log->println(F("OTA: Writing to flash failed."));
+        esp_ota_abort(otaHandler);
+        return false;
+    }
+
+    if(_verifySha256 && memcmp(digest, _expectedSha256, sizeof(_expectedSha256)) != 0)
+    {
+        Log->println(F("OTA: SHA-256 digest mismatch, discarding update."));
+        esp_ota_abort(otaHandler);
+        return false;
+    }
+
+    if(esp_ota_end(otaHandler) != ESP_OK)
+    {
+        Log->println(F("OTA: Image validation failed."));
+        return false;
+    }
+    Log->println("EndOTA");
+
+    if(esp_ota_set_boot_partition(esp_ota_get_next_update_partition(NULL)) != ESP_OK)
+    {
+        Log->println("Upload Error");
+        return false;
+    }
+
+    _updateCompleted = true;
+    return true;
+}
+
+void Ota::abort()
+{
+    if(!_updateStarted)
+    {
+        return;
+    }
+
+    waitForWriter();
+    mbedtls_sha256_free(&_sha256);
+    releaseBuffers();
+    esp_ota_abort(otaHandler);
+    otaHandler = 0;
+    _updateStarted = false;
+}
+
+bool Ota::submitBuffer()
+{
+    xQueueSend(_filledBuffers, &_currentBuffer, portMAX_DELAY);
+    // Blocks until the writer has finished the other buffer, receiving continues while the current one is written
+    xQueueReceive(_freeBuffers, &_currentBuffer, portMAX_DELAY);
+    _bufferLength[_currentBuffer] = 0;
+    return !_writeError;
+}
+
+void Ota::waitForWriter()
+{
+    if(_writerTaskHandle == nullptr)
+    {
+        return;
+    }
+
+    // The buffer not held by the upload is back in the free queue once the writer is idle
+    int index;
+    xQueueReceive(_freeBuffers, &index, portMAX_DELAY);
+
+    vTaskDelete(_writerTaskHandle);
+    _writerTaskHandle = nullptr;
+}
+
+void Ota::releaseBuffers()
+{
+    free(_buffers[0]);
+    free(_buffers[1]);
+    _buffers[0] = nullptr;
+    _buffers[1] = nullptr;
+
+    if(_freeBuffers != nullptr)
+    {
+        vQueueDelete(_freeBuffers);
+        _freeBuffers = nullptr;
+    }
+    if(_filledBuffers != nullptr)
+    {
+        vQueueDelete(_filledBuffers);
+        _filledBuffers = nullptr;
+    }
+}
+
+void Ota::writerTask(void* param)
+{
+    Ota* ota = (Ota*)param;
+    int index;
+
+    while(true)
+    {
+        xQueueReceive(ota->_filledBuffers, &index, portMAX_DELAY);
+
+        if(!ota->_writeError && esp_ota_write(ota->otaHandler, ota->_buffers[index], ota->_bufferLength[index]) != ESP_OK)
         {
-            Log->println("Upload Error");
+            ota->_writeError = true;
         }
+        ota->_bufferLength[index] = 0;
+        xQueueSend(ota->_freeBuffers, &index, portMAX_DELAY);
     }
 }
 
@@ -45,8 +243,7 @@ bool Ota::updateCompleted()
     return _updateCompleted;
 }
 
-void Ota::restart()
+size_t Ota::bytesWritten()
 {
-    _updateCompleted = false;
-    _updateStarted = false;
+    return _bytesWritten;
 }
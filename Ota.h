@@ -2,19 +2,52 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
 
+#define OTA_BUFFER_SIZE 4096
+#define OTA_SHA256_HEX_LENGTH 64
+#define OTA_PROGRESS_INTERVAL 65536 // bytes between progress reports
+
+// Used by the browser upload and the HTTP mirror download. begin() claims the update for the caller and fails
+// while another one is in progress, end() and abort() release it.
 class Ota
 {
 public:
-    void updateFirmware(uint8_t* buf, size_t size);
+    bool begin(const char* expectedSha256 = nullptr);
+    bool write(const uint8_t* buf, size_t size);
+    bool end();
+    void abort();
 
     bool updateStarted();
     bool updateCompleted();
-    void restart();
+    size_t bytesWritten();
 
 private:
-    bool _updateStarted = false;
+    static void writerTask(void* param);
+    bool activate(const uint8_t* digest);
+    bool submitBuffer();
+    void waitForWriter();
+    void releaseBuffers();
+
+    std::atomic<bool> _updateStarted{false};
     bool _updateCompleted = false;
+    volatile bool _writeError = false;
     esp_ota_handle_t otaHandler = 0;
+
+    // Two buffers alternate between being filled by the upload and written to flash by the writer task
+    uint8_t* _buffers[2] = {nullptr, nullptr};
+    size_t _bufferLength[2] = {0, 0};
+    int _currentBuffer = -1;
+    QueueHandle_t _freeBuffers = nullptr;
+    QueueHandle_t _filledBuffers = nullptr;
+    TaskHandle_t _writerTaskHandle = nullptr;
+
+    size_t _bytesWritten = 0;
+    mbedtls_sha256_context _sha256;
+    bool _verifySha256 = false;
+    uint8_t _expectedSha256[32] = {0};
 };
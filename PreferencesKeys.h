@@ -11,6 +11,7 @@
 #define preference_mqtt_user "mqttuser"
 #define preference_mqtt_password "mqttpass"
 #define preference_mqtt_log_enabled "mqttlog"
+#define preference_mqtt_v5 "mqttv5"
 #define preference_lock_enabled "lockena"
 #define preference_mqtt_lock_path "mqttpath"
 #define preference_opener_enabled "openerena"
@@ -52,13 +53,19 @@
 #define preference_publish_authdata "pubauth"
 #define preference_gpio_locking_enabled "gpiolck" // obsolete
 #define preference_gpio_configuration "gpiocfg"
+#define preference_gpio_debounce "gpiodbnc"
 #define preference_publish_debug_info "pubdbg"
 #define preference_presence_detection_timeout "prdtimeout"
+#define preference_presence_delta_enabled "prddelta"
+#define preference_presence_full_interval "prdfullint"
+#define preference_presence_watchlist "prdwatch"
 #define preference_has_mac_saved "hasmac"
 #define preference_has_mac_byte_0 "macb0"
 #define preference_has_mac_byte_1 "macb1"
 #define preference_has_mac_byte_2 "macb2"
 #define preference_latest_version "latest"
+#define preference_ota_mirror_url "otaMirror"
+#define preference_update_check_url "updChkUrl"
 
 class DebugPreferences
 {
@@ -66,7 +73,7 @@ private:
     std::vector<char*> _keys =
     {
             preference_started_before, preference_config_version, preference_device_id_lock, preference_device_id_opener, preference_mqtt_broker, 
-            preference_mqtt_broker_port, preference_mqtt_user, preference_mqtt_password, preference_mqtt_log_enabled, preference_check_updates, preference_lock_enabled,
+            preference_mqtt_broker_port, preference_mqtt_user, preference_mqtt_password, preference_mqtt_log_enabled, preference_mqtt_v5, preference_check_updates, preference_lock_enabled,
             preference_mqtt_lock_path, preference_opener_enabled, preference_opener_continuous_mode, preference_mqtt_opener_path,
             preference_lock_max_keypad_code_count, preference_opener_max_keypad_code_count, preference_mqtt_ca,
             preference_mqtt_crt, preference_mqtt_key, preference_mqtt_hass_discovery, preference_mqtt_hass_cu_url,
@@ -78,8 +85,10 @@ private:
             preference_keypad_control_enabled, preference_access_level,
             preference_register_as_app, preference_command_nr_of_retries,
             preference_command_retry_delay, preference_cred_user, preference_cred_password, preference_publish_authdata,
-            preference_publish_debug_info, preference_presence_detection_timeout,
+            preference_publish_debug_info, preference_presence_detection_timeout, preference_presence_delta_enabled, preference_presence_full_interval,
+            preference_presence_watchlist,
             preference_has_mac_saved, preference_has_mac_byte_0, preference_has_mac_byte_1, preference_has_mac_byte_2, preference_latest_version,
+            preference_ota_mirror_url, preference_update_check_url, preference_gpio_debounce,
     };
     std::vector<char*> _redact =
     {
@@ -89,9 +98,10 @@ private:
     };
     std::vector<char*> _boolPrefs =
     {
-            preference_started_before, preference_mqtt_log_enabled, preference_check_updates, preference_lock_enabled, preference_opener_enabled, preference_opener_continuous_mode,
+            preference_started_before, preference_mqtt_log_enabled, preference_mqtt_v5, preference_check_updates, preference_lock_enabled, preference_opener_enabled, preference_opener_continuous_mode,
             preference_restart_on_disconnect, preference_keypad_control_enabled, preference_register_as_app, preference_ip_dhcp_enabled,
-            preference_publish_authdata, preference_has_mac_saved, preference_publish_debug_info, preference_network_wifi_fallback_disabled
+            preference_publish_authdata, preference_has_mac_saved, preference_publish_debug_info, preference_network_wifi_fallback_disabled,
+            preference_presence_delta_enabled
     };
 
     const bool isRedacted(const char* key) const
@@ -189,6 +199,26 @@ private:
         s.concat(isRedacted(key) ? redact(preferences->getString(key)) : preferences->getString(key));
         s.concat("\n");
     }
+    const void appendPreferenceBytes(Preferences *preferences, String& s, const char* description, const char* key)
+    {
+        uint8_t buffer[128];
+        size_t length = preferences->getBytes(key, buffer, sizeof(buffer));
+        char hex[3];
+
+        s.concat(description);
+        s.concat(": ");
+        if(length == 0 && preferences->getBytesLength(key) > 0)
+        {
+            s.concat(preferences->getBytesLength(key));
+            s.concat(" bytes");
+        }
+        for(size_t i = 0; i < length; i++)
+        {
+            sprintf(hex, "%02x", buffer[i]);
+            s.concat(hex);
+        }
+        s.concat("\n");
+    }
 
     const void appendPreference(Preferences *preferences, String& s, const char* key)
     {
@@ -227,6 +257,9 @@ private:
             case PT_STR:
                 appendPreferenceString(preferences, s, key, key);
                 break;
+            case PT_BLOB:
+                appendPreferenceBytes(preferences, s, key, key);
+                break;
             default:
                 appendPreferenceString(preferences, s, key, key);
                 break;
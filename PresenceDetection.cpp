@@ -1,18 +1,18 @@
 #include "PresenceDetection.h"
 #include "PreferencesKeys.h"
 #include "Logger.h"
-#include "CharBuffer.h"
 #include <NimBLEDevice.h>
 #include <NimBLEAdvertisedDevice.h>
 #include "NimBLEBeacon.h"
 #include "NukiUtils.h"
 
-PresenceDetection::PresenceDetection(Preferences* preferences, BleScanner::Scanner *bleScanner, Network* network, char* buffer, size_t bufferSize)
+PresenceDetection::PresenceDetection(Preferences* preferences, BleScanner::Scanner *bleScanner, Network* network)
 : _preferences(preferences),
   _bleScanner(bleScanner),
   _network(network),
-  _csv(buffer),
-  _bufferSize(bufferSize)
+  _eventSnapshot(PRESENCE_EVENT_SNAPSHOT_SIZE, true),
+  _sightingWriteIndex(0),
+  _sightingReadIndex(0)
 {
     _timeout = _preferences->getInt(preference_presence_detection_timeout) * 1000;
     if(_timeout == 0)
@@ -23,68 +23,304 @@ PresenceDetection::PresenceDetection(Preferences* preferences, BleScanner::Scann
 
     Log->print(F("Presence detection timeout (ms): "));
     Log->println(_timeout);
+
+    _watchlist.compile(_preferences->getString(preference_presence_watchlist));
+
+    _deltaEnabled = _preferences->getBool(preference_presence_delta_enabled);
+    int fullPublishInterval = _preferences->getInt(preference_presence_full_interval);
+    if(fullPublishInterval > 0)
+    {
+        _fullPublishInterval = fullPublishInterval * 1000;
+    }
 }
 
 PresenceDetection::~PresenceDetection()
 {
     _bleScanner->unsubscribe(this);
+    _bleScanner->setHighDutyRequired(false);
     _bleScanner = nullptr;
 
+    _network->setPresenceSnapshot(nullptr, nullptr);
     _network = nullptr;
 
-    delete _csv;
     _csv = nullptr;
 }
 
 void PresenceDetection::initialize()
 {
-    _bleScanner->subscribe(this);
+    _network->setPresenceSnapshot(&_snapshot, _deltaEnabled ? &_eventSnapshot : nullptr);
+    BleScanner::Filter filter;
+    _watchlist.buildScanFilter(filter);
+    _bleScanner->subscribe(this, filter);
+    _bleScanner->setHighDutyRequired(_timeout >= 0);
 }
 
 void PresenceDetection::update()
 {
-    delay(3000);
+    delay(PRESENCE_DETECTION_DRAIN_INTERVAL);
 
     if(_timeout < 0) return;
-    memset(_csv, 0, _bufferSize);
 
-    if(_devices.size() == 0)
+    processSightings();
+
+    if(millis() - _lastPublishTs < PRESENCE_DETECTION_PUBLISH_INTERVAL)
     {
-        strcpy(_csv, ";;");
-        _network->publishPresenceDetection(_csv);
         return;
     }
+    _lastPublishTs = millis();
+
+    if(!_deltaEnabled)
+    {
+        publishCsv();
+        return;
+    }
+
+    publishEvents();
+
+    if(_snapshot.refreshRequested())
+    {
+        _fullPublishPending = true;
+    }
+
+    if(_fullPublishPending || millis() - _lastFullPublishTs >= _fullPublishInterval)
+    {
+        if(publishCsv())
+        {
+            _fullPublishPending = false;
+            _lastFullPublishTs = millis();
+        }
+    }
+}
+
+void PresenceDetection::processSightings()
+{
+    uint32_t readIndex = _sightingReadIndex.load(std::memory_order_relaxed);
+    uint32_t writeIndex = _sightingWriteIndex.load(std::memory_order_acquire);
+
+    while(readIndex != writeIndex)
+    {
+        storeSighting(_sightings[readIndex & (PRESENCE_DETECTION_SIGHTING_BUFFER_SIZE - 1)]);
+        ++readIndex;
+        _sightingReadIndex.store(readIndex, std::memory_order_release);
+    }
+}
+
+void PresenceDetection::storeSighting(const PdSighting& sighting)
+{
+    PdDevice* pdDevice = findDevice(sighting.address);
+
+    if(pdDevice == nullptr)
+    {
+        // Only devices with a name or a matching iBeacon are tracked, other sightings just refresh known devices
+        if(sighting.name[0] == 0x00)
+        {
+            return;
+        }
+        pdDevice = insertDevice(sighting.address);
+        if(pdDevice == nullptr)
+        {
+            // Table full of devices waiting for their leave event, the device will be seen again
+            return;
+        }
+        memcpy(pdDevice->name, sighting.name, sizeof(pdDevice->name));
+    }
+
+    pdDevice->timestamp = millis();
+    if(sighting.hasRssi)
+    {
+        updateRssi(*pdDevice, sighting.rssi);
+    }
+    if(sighting.hasTxPower)
+    {
+        pdDevice->hasTxPower = true;
+        pdDevice->txPower = sighting.txPower;
+    }
+}
+
+void PresenceDetection::updateRssi(PdDevice& device, const int& rssi)
+{
+    const int32_t sample = rssi * 256;
+
+    if(!device.hasRssi)
+    {
+        device.hasRssi = true;
+        device.rssiAverage = sample;
+        device.rssiVariance = 0;
+        return;
+    }
+
+    // Exponentially weighted mean and variance, in fixed point so the update stays cheap for every advertisement
+    const int32_t diff = sample - device.rssiAverage;
+    const int32_t increment = diff / (1 << PRESENCE_DETECTION_RSSI_SMOOTHING_SHIFT);
+    device.rssiAverage += increment;
+
+    uint32_t variance = device.rssiVariance + (uint32_t)(((int64_t)diff * increment) / 256);
+    device.rssiVariance = variance - (variance >> PRESENCE_DETECTION_RSSI_SMOOTHING_SHIFT);
+}
+
+int PresenceDetection::smoothedRssi(const PdDevice& device)
+{
+    return (device.rssiAverage + (device.rssiAverage < 0 ? -128 : 128)) / 256;
+}
+
+bool PresenceDetection::rssiChanged(const PdDevice& device)
+{
+    if(!device.hasRssi)
+    {
+        return false;
+    }
+
+    // Changes within two standard deviations of the signal noise are not reported
+    int threshold = PRESENCE_DETECTION_RSSI_THRESHOLD;
+    int noise = (int)(2 * sqrtf(device.rssiVariance / 256.0f));
+    if(noise > threshold)
+    {
+        threshold = noise;
+    }
+
+    return abs(smoothedRssi(device) - device.publishedRssi) >= threshold;
+}
+
+int PresenceDetection::estimateDistance(const PdDevice& device)
+{
+    if(!device.hasRssi || !device.hasTxPower)
+    {
+        return -1;
+    }
+
+    // Log-distance path loss model
+    float exponent = (device.txPower - device.rssiAverage / 256.0f) / (10.0f * PRESENCE_DETECTION_PATH_LOSS_EXPONENT);
+    return (int)(powf(10.0f, exponent) * 10.0f + 0.5f);
+}
+
+bool PresenceDetection::publishCsv()
+{
+    // The network task may still be publishing the previous snapshot, try again next time
+    _csv = _snapshot.beginWrite();
+    if(_csv == nullptr) return false;
+    _bufferSize = _snapshot.size();
 
     _csvIndex = 0;
     long ts = millis();
-    for(auto it : _devices)
+    for(const auto& device : _devices)
     {
-        if(ts - _timeout < it.second.timestamp)
+        if(device.address != 0 && ts - _timeout < device.timestamp)
         {
-            buildCsv(it.second);
+            buildCsv(device);
         }
 
         // Prevent csv buffer overflow
-        if(_csvIndex > _bufferSize - (sizeof(it.second.name) + sizeof(it.second.address) + 10))
+        if(_csvIndex > _bufferSize - (sizeof(device.name) + 18 + 20))
         {
             break;
         }
     }
 
-    _csv[_csvIndex-1] = 0x00;
+    if(_csvIndex == 0)
+    {
+        strcpy(_csv, ";;");
+    }
+    else
+    {
+        _csv[_csvIndex-1] = 0x00;
+    }
 
-//    Log->print("Devices found: ");
-//    Log->println(_devices.size());
-    _network->publishPresenceDetection(_csv);
+    _snapshot.commit();
+    return true;
+}
+
+void PresenceDetection::publishEvents()
+{
+    _csv = _eventSnapshot.beginWrite();
+    if(_csv == nullptr) return;
+    _bufferSize = _eventSnapshot.size();
+
+    _csvIndex = 0;
+
+    // Devices evicted from the table while published as present
+    size_t leaves = 0;
+    while(leaves < _pendingLeaveCount && _csvIndex <= _bufferSize - (sizeof(PdDevice::name) + 18 + 26))
+    {
+        strcpy(_csv + _csvIndex, "leave;");
+        _csvIndex += 6;
+        buildCsv(_pendingLeaves[leaves]);
+        ++leaves;
+    }
+    for(size_t i = leaves; i < _pendingLeaveCount; i++)
+    {
+        _pendingLeaves[i - leaves] = _pendingLeaves[i];
+    }
+    _pendingLeaveCount -= leaves;
+
+    long ts = millis();
+    for(auto& device : _devices)
+    {
+        if(device.address == 0)
+        {
+            continue;
+        }
+
+        const bool present = ts - _timeout < device.timestamp;
+        const char* event = nullptr;
+
+        if(present && !device.published)
+        {
+            event = "enter;";
+        }
+        else if(!present && device.published)
+        {
+            event = "leave;";
+        }
+        else if(present && rssiChanged(device))
+        {
+            event = "rssi;";
+        }
+
+        if(event == nullptr)
+        {
+            continue;
+        }
+
+        // Remaining changes are picked up with the next round
+        if(_csvIndex > _bufferSize - (sizeof(device.name) + 18 + 26))
+        {
+            break;
+        }
+
+        strcpy(_csv + _csvIndex, event);
+        _csvIndex += strlen(event);
+        buildCsv(device);
+
+        device.published = present;
+        device.publishedRssi = smoothedRssi(device);
+    }
+
+    if(_csvIndex == 0)
+    {
+        return;
+    }
+
+    _csv[_csvIndex-1] = 0x00;
+    _eventSnapshot.commit();
 }
 
 
 void PresenceDetection::buildCsv(const PdDevice &device)
 {
-    for(int i = 0; i < 17; i++)
+    static const char hexDigits[] = "0123456789abcdef";
+
+    for(int i = 5; i >= 0; i--)
     {
-        _csv[_csvIndex] = device.address[i];
+        uint8_t addressByte = (device.address >> (i * 8)) & 0xff;
+        _csv[_csvIndex] = hexDigits[addressByte >> 4];
         ++_csvIndex;
+        _csv[_csvIndex] = hexDigits[addressByte & 0x0f];
+        ++_csvIndex;
+        if(i > 0)
+        {
+            _csv[_csvIndex] = ':';
+            ++_csvIndex;
+        }
     }
     _csv[_csvIndex] = ';';
     ++_csvIndex;
@@ -102,122 +338,251 @@ void PresenceDetection::buildCsv(const PdDevice &device)
 
     if(device.hasRssi)
     {
-        char rssiStr[20] = {0};
-        itoa(device.rssi, rssiStr, 10);
+        appendNumber(smoothedRssi(device));
+    }
 
-        int i=0;
-        while(rssiStr[i] != 0x00 && i < 20)
-        {
-            _csv[_csvIndex] = rssiStr[i];
-            ++_csvIndex;
-            ++i;
-        }
+    int distance = estimateDistance(device);
+    if(distance >= 0)
+    {
+        // Meters with one decimal
+        _csv[_csvIndex] = ';';
+        ++_csvIndex;
+        appendNumber(distance / 10);
+        _csv[_csvIndex] = '.';
+        ++_csvIndex;
+        _csv[_csvIndex] = '0' + distance % 10;
+        ++_csvIndex;
     }
 
     _csv[_csvIndex] = '\n';
     _csvIndex++;
 }
 
-void PresenceDetection::onResult(NimBLEAdvertisedDevice *device)
+void PresenceDetection::appendNumber(const int& value)
 {
-    std::string addressStr = device->getAddress().toString();
-    char addrArrComp[13] = {0};
+    char valueStr[20] = {0};
+    itoa(value, valueStr, 10);
 
-//    Log->println(addressStr.c_str());
+    int i=0;
+    while(valueStr[i] != 0x00 && i < 20)
+    {
+        _csv[_csvIndex] = valueStr[i];
+        ++_csvIndex;
+        ++i;
+    }
+}
 
-    addrArrComp[0] = addressStr.at(0);
-    addrArrComp[1] = addressStr.at(1);
-    addrArrComp[2] = addressStr.at(3);
-    addrArrComp[3] = addressStr.at(4);
-    addrArrComp[4] = addressStr.at(6);
-    addrArrComp[5] = addressStr.at(7);
-    addrArrComp[6] = addressStr.at(9);
-    addrArrComp[7] = addressStr.at(10);
-    addrArrComp[8] = addressStr.at(12);
-    addrArrComp[9] = addressStr.at(13);
-    addrArrComp[10] = addressStr.at(15);
-    addrArrComp[11] = addressStr.at(16);
+void PresenceDetection::onResult(NimBLEAdvertisedDevice *device)
+{
+    onAdvertisement(device, BleScanner::Advertisement(device));
+}
 
-    long long addr = strtoll(addrArrComp, nullptr, 16);
+void PresenceDetection::onAdvertisement(NimBLEAdvertisedDevice *device, const BleScanner::Advertisement& advertisement)
+{
+    // Runs in the NimBLE host task, only hands the sighting over to the presence detection task
+    if(_timeout < 0) return;
 
-    auto it = _devices.find(addr);
-    if(it == _devices.end())
+    uint32_t writeIndex = _sightingWriteIndex.load(std::memory_order_relaxed);
+    if(writeIndex - _sightingReadIndex.load(std::memory_order_acquire) >= PRESENCE_DETECTION_SIGHTING_BUFFER_SIZE)
     {
+        // Buffer full, the device will be seen again with the next advertisement
+        return;
+    }
 
-        PdDevice pdDevice;
+    const uint64_t address = advertisement.address;
+    const bool filtered = !_watchlist.isEmpty();
+    bool matched = !filtered || _watchlist.matchesAddress(address);
 
-        int i=0;
-        size_t len = addressStr.length();
-        while(i < len)
-        {
-            pdDevice.address[i] = addressStr.at(i);
-            ++i;
-        }
+    PdSighting& sighting = _sightings[writeIndex & (PRESENCE_DETECTION_SIGHTING_BUFFER_SIZE - 1)];
+    sighting.hasTxPower = false;
 
-        if(device->haveRSSI())
+    if(device->haveName())
+    {
+        const std::string& nameStr = device->getName();
+        if(!matched && _watchlist.matchesName(nameStr.c_str(), nameStr.length()))
         {
-            pdDevice.hasRssi = true;
-            pdDevice.rssi = device->getRSSI();
+            matched = true;
+            _watchlist.learnAddress(address);
         }
+        if(!matched) return;
 
-        std::string nameStr = "-";
-        if(device->haveName())
-        {
-            std::string nameStr = device->getName();
+        memset(sighting.name, 0, sizeof(sighting.name));
+        strncpy(sighting.name, nameStr.c_str(), sizeof(sighting.name) - 1);
+    }
+    else if (advertisement.haveManufacturerData)
+    {
+        const std::string& strManufacturerData = advertisement.manufacturerData;
+        memset(sighting.name, 0, sizeof(sighting.name));
 
-            i=0;
-            len = nameStr.length();
-            while(i < len && i < sizeof(pdDevice.name)-1)
+        if (strManufacturerData.length() == 25 && strManufacturerData[0] == 0x4C && strManufacturerData[1] == 0x00)
+        {
+            // iBeacon: company id, type, length, 16 byte proximity UUID, major, minor, tx power
+            if(!matched && _watchlist.matchesBeaconUuid((const uint8_t*)strManufacturerData.data() + 4))
             {
-                pdDevice.name[i] = nameStr.at(i);
-                ++i;
+                matched = true;
+                _watchlist.learnAddress(address);
+                // Let the beacon's advertisements without beacon data through the scanner as well
+                BleScanner::Filter filter;
+                _watchlist.buildScanFilter(filter);
+                _bleScanner->setFilter(this, filter);
             }
+            if(!matched) return;
 
-            pdDevice.timestamp = millis();
+            BLEBeacon oBeacon = BLEBeacon();
+            oBeacon.setData(strManufacturerData);
+
+            if(filtered || ENDIAN_CHANGE_U16(oBeacon.getMinor()) == 40004)
+            {
+                strcpy(sighting.name, oBeacon.getProximityUUID().toString().c_str());
+            }
 
-            _devices[addr] = pdDevice;
+            // The beacon advertises its calibrated RSSI at 1 m
+            sighting.hasTxPower = true;
+            sighting.txPower = oBeacon.getSignalPower();
         }
-        else if (device->haveManufacturerData())
+    }
+    else
+    {
+        memset(sighting.name, 0, sizeof(sighting.name));
+    }
+
+    if(!matched) return;
+
+    // Watched devices are tracked even if they don't advertise a name
+    if(filtered && sighting.name[0] == 0x00)
+    {
+        strcpy(sighting.name, "-");
+    }
+
+    sighting.address = address;
+    sighting.hasRssi = device->haveRSSI();
+    sighting.rssi = sighting.hasRssi ? device->getRSSI() : 0;
+
+    if(!sighting.hasTxPower && device->haveTXPower())
+    {
+        sighting.hasTxPower = true;
+        sighting.txPower = device->getTXPower() - PRESENCE_DETECTION_TX_POWER_1M_OFFSET;
+    }
+
+    _sightingWriteIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+size_t PresenceDetection::hashAddress(const uint64_t& address)
+{
+    uint32_t folded = (uint32_t)(address ^ (address >> 24));
+    return ((folded * 2654435761u) >> 16) & (PRESENCE_DETECTION_TABLE_SIZE - 1);
+}
+
+PdDevice* PresenceDetection::findDevice(const uint64_t& address)
+{
+    size_t index = hashAddress(address);
+
+    // Linear probing, the table is never full so an empty slot always ends the search
+    while(_devices[index].address != 0)
+    {
+        if(_devices[index].address == address)
         {
-            std::string strManufacturerData = device->getManufacturerData();
+            return &_devices[index];
+        }
+        index = (index + 1) & (PRESENCE_DETECTION_TABLE_SIZE - 1);
+    }
+    return nullptr;
+}
 
-            uint8_t cManufacturerData[100];
-            strManufacturerData.copy((char *)cManufacturerData,  std::min(strManufacturerData.length(), sizeof(cManufacturerData)), 0);
+PdDevice* PresenceDetection::insertDevice(const uint64_t& address)
+{
+    if(_deviceCount >= PRESENCE_DETECTION_MAX_DEVICES && !evictDevice())
+    {
+        return nullptr;
+    }
 
-            if (strManufacturerData.length() == 25 && cManufacturerData[0] == 0x4C && cManufacturerData[1] == 0x00)
-            {
-                BLEBeacon oBeacon = BLEBeacon();
-                oBeacon.setData(strManufacturerData);
-
-                if(ENDIAN_CHANGE_U16(oBeacon.getMinor()) == 40004)
-                {
-                    pdDevice.timestamp = millis();
-                    strcpy(pdDevice.name, oBeacon.getProximityUUID().toString().c_str());
-                    _devices[addr] = pdDevice;
-                }
-            }
+    size_t index = hashAddress(address);
+    while(_devices[index].address != 0)
+    {
+        index = (index + 1) & (PRESENCE_DETECTION_TABLE_SIZE - 1);
+    }
+
+    _devices[index] = PdDevice();
+    _devices[index].address = address;
+    ++_deviceCount;
+    return &_devices[index];
+}
+
+void PresenceDetection::removeDevice(size_t index)
+{
+    // Backward shift deletion, moves entries of the same probe sequence into the gap so no tombstones are needed
+    size_t next = (index + 1) & (PRESENCE_DETECTION_TABLE_SIZE - 1);
+    while(_devices[next].address != 0)
+    {
+        size_t home = hashAddress(_devices[next].address);
+        if(((next - home) & (PRESENCE_DETECTION_TABLE_SIZE - 1)) >= ((next - index) & (PRESENCE_DETECTION_TABLE_SIZE - 1)))
+        {
+            _devices[index] = _devices[next];
+            index = next;
         }
+        next = (next + 1) & (PRESENCE_DETECTION_TABLE_SIZE - 1);
     }
-    else
+
+    _devices[index] = PdDevice();
+    --_deviceCount;
+}
+
+bool PresenceDetection::evictDevice()
+{
+    // Drop all timed out devices, if none has timed out drop the least recently seen one
+    unsigned long ts = millis();
+    size_t oldestIndex = 0;
+    unsigned long oldestAge = 0;
+    bool found = false;
+    bool removed = false;
+
+    size_t index = 0;
+    while(index < PRESENCE_DETECTION_TABLE_SIZE)
     {
-        it->second.timestamp = millis();
-        if(device->haveRSSI())
+        if(_devices[index].address == 0 || !evictable(_devices[index]))
+        {
+            ++index;
+            continue;
+        }
+
+        unsigned long age = ts - _devices[index].timestamp;
+        if(_timeout >= 0 && age > (unsigned long)_timeout)
         {
-            it->second.hasRssi = true;
-            it->second.rssi = device->getRSSI();
+            removeEvictedDevice(index);
+            removed = true;
+            // Another entry may have been shifted into this slot
+            continue;
         }
+
+        if(age >= oldestAge)
+        {
+            oldestAge = age;
+            oldestIndex = index;
+            found = true;
+        }
+        ++index;
     }
 
-//    if(device->haveName())
-//    {
-//        Log->print(" | ");
-//        Log->print(device->getName().c_str());
-//        if(device->haveRSSI())
-//        {
-//            Log->print(" | ");
-//            Log->print(device->getRSSI());
-//        }
-//    }
-//    Log->println();
+    if(!removed && found)
+    {
+        removeEvictedDevice(oldestIndex);
+        removed = true;
+    }
+    return removed;
+}
 
-}
\ No newline at end of file
+bool PresenceDetection::evictable(const PdDevice& device) const
+{
+    // A device published as present needs a leave event, which has to wait in the pending list
+    return !_deltaEnabled || !device.published || _pendingLeaveCount < PRESENCE_DETECTION_MAX_PENDING_LEAVES;
+}
+
+void PresenceDetection::removeEvictedDevice(size_t index)
+{
+    if(_deltaEnabled && _devices[index].published)
+    {
+        _pendingLeaves[_pendingLeaveCount] = _devices[index];
+        ++_pendingLeaveCount;
+    }
+    removeDevice(index);
+}
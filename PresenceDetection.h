@@ -3,36 +3,106 @@
 #include "BleScanner.h"
 #include "BleInterfaces.h"
 #include "Network.h"
+#include "PresenceSnapshot.h"
+#include "PresenceWatchlist.h"
+#include <atomic>
+
+#define PRESENCE_DETECTION_TABLE_SIZE 64 // must be a power of two
+#define PRESENCE_DETECTION_MAX_DEVICES 48 // keeps the probe sequences of the table short
+#define PRESENCE_DETECTION_SIGHTING_BUFFER_SIZE 32 // must be a power of two
+#define PRESENCE_DETECTION_MAX_PENDING_LEAVES 8 // evicted devices waiting for their leave event
+#define PRESENCE_DETECTION_DRAIN_INTERVAL 100
+#define PRESENCE_DETECTION_PUBLISH_INTERVAL 3000
+#define PRESENCE_DETECTION_FULL_PUBLISH_INTERVAL 300 // seconds, default when publishing changes only
+#define PRESENCE_DETECTION_RSSI_THRESHOLD 10 // minimum dBm change of the smoothed RSSI that is published as an event
+#define PRESENCE_DETECTION_RSSI_SMOOTHING_SHIFT 3 // moving average weight of a new sample is 1/8
+#define PRESENCE_DETECTION_PATH_LOSS_EXPONENT 2.5f // typical indoor value, 2.0 in free space
+#define PRESENCE_DETECTION_TX_POWER_1M_OFFSET 41 // signal loss in the first meter, converts tx power level to RSSI at 1 m
 
 struct PdDevice
 {
-    char address[18] = {0};
+    uint64_t address = 0; // 48 bit BLE address, 0 marks an empty slot
     char name[37] = {0};
     unsigned long timestamp = 0;
+    int32_t rssiAverage = 0; // dBm, fixed point with 8 fractional bits
+    uint32_t rssiVariance = 0; // dBm², fixed point with 8 fractional bits
+    bool hasRssi = false;
+    int8_t txPower = 0; // expected RSSI at 1 m
+    bool hasTxPower = false;
+    bool published = false; // included in the last published events as present
+    int publishedRssi = 0;
+};
+
+// Filled in the NimBLE callback and handed to the presence detection task
+struct PdSighting
+{
+    uint64_t address = 0;
+    char name[37] = {0};
     int rssi = 0;
     bool hasRssi = false;
+    int8_t txPower = 0;
+    bool hasTxPower = false;
 };
 
 class PresenceDetection : public BleScanner::Subscriber
 {
 public:
-    PresenceDetection(Preferences* preferences, BleScanner::Scanner* bleScanner, Network* network, char* buffer, size_t bufferSize);
+    PresenceDetection(Preferences* preferences, BleScanner::Scanner* bleScanner, Network* network);
     virtual ~PresenceDetection();
 
     void initialize();
     void update();
 
     void onResult(NimBLEAdvertisedDevice* advertisedDevice) override;
+    void onAdvertisement(NimBLEAdvertisedDevice* advertisedDevice, const BleScanner::Advertisement& advertisement) override;
 
 private:
+    void processSightings();
+    void storeSighting(const PdSighting& sighting);
+    bool publishCsv();
+    void publishEvents();
     void buildCsv(const PdDevice& device);
+    void appendNumber(const int& value);
+
+    static void updateRssi(PdDevice& device, const int& rssi);
+    static int smoothedRssi(const PdDevice& device);
+    static bool rssiChanged(const PdDevice& device);
+    static int estimateDistance(const PdDevice& device); // decimeters, -1 if unknown
+
+    static size_t hashAddress(const uint64_t& address);
+    PdDevice* findDevice(const uint64_t& address);
+    PdDevice* insertDevice(const uint64_t& address);
+    void removeDevice(size_t index);
+    bool evictDevice();
+    bool evictable(const PdDevice& device) const;
+    void removeEvictedDevice(size_t index);
 
     Preferences* _preferences;
     BleScanner::Scanner* _bleScanner;
     Network* _network;
     char* _csv = {0};
     size_t _bufferSize = 0;
-    std::map<long long, PdDevice> _devices;
+    PresenceSnapshot _snapshot;
+    PresenceSnapshot _eventSnapshot;
+    unsigned long _lastPublishTs = 0;
+    unsigned long _lastFullPublishTs = 0;
+    unsigned long _fullPublishInterval = PRESENCE_DETECTION_FULL_PUBLISH_INTERVAL * 1000;
+    bool _deltaEnabled = false;
+    bool _fullPublishPending = true;
+
+    // Used only by onAdvertisement()
+    PresenceWatchlist _watchlist;
+
+    // Written only by onAdvertisement(), read only by the presence detection task
+    PdSighting _sightings[PRESENCE_DETECTION_SIGHTING_BUFFER_SIZE];
+    std::atomic<uint32_t> _sightingWriteIndex;
+    std::atomic<uint32_t> _sightingReadIndex;
+
+    // Owned by the presence detection task
+    PdDevice _devices[PRESENCE_DETECTION_TABLE_SIZE];
+    size_t _deviceCount = 0;
+    PdDevice _pendingLeaves[PRESENCE_DETECTION_MAX_PENDING_LEAVES];
+    size_t _pendingLeaveCount = 0;
     int _timeout = 20000;
     int _csvIndex = 0;
 };
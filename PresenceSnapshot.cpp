@@ -0,0 +1,72 @@
+#include "PresenceSnapshot.h"
+#include <cstring>
+
+PresenceSnapshot::PresenceSnapshot(const size_t& size, const bool& keepUnread)
+: _size(size),
+  _keepUnread(keepUnread),
+  _sequence(0),
+  _releasedSequence(0),
+  _refreshRequested(false)
+{
+    _buffers[0] = new char[_size];
+    _buffers[1] = new char[_size];
+    memset(_buffers[0], 0, _size);
+    memset(_buffers[1], 0, _size);
+}
+
+PresenceSnapshot::~PresenceSnapshot()
+{
+    delete[] _buffers[0];
+    delete[] _buffers[1];
+}
+
+char* PresenceSnapshot::beginWrite()
+{
+    uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+
+    // The next buffer is the one of sequence - 1, the reader may still be publishing it
+    const uint32_t released = _releasedSequence.load(std::memory_order_acquire);
+    if(released + 1 < sequence || (_keepUnread && released != sequence))
+    {
+        return nullptr;
+    }
+
+    char* buffer = _buffers[(sequence + 1) & 1];
+    memset(buffer, 0, _size);
+    return buffer;
+}
+
+void PresenceSnapshot::commit()
+{
+    _sequence.fetch_add(1, std::memory_order_release);
+}
+
+const size_t PresenceSnapshot::size() const
+{
+    return _size;
+}
+
+const char* PresenceSnapshot::acquire(uint32_t& sequence)
+{
+    sequence = _sequence.load(std::memory_order_acquire);
+    if(sequence == _releasedSequence.load(std::memory_order_relaxed))
+    {
+        return nullptr;
+    }
+    return _buffers[sequence & 1];
+}
+
+void PresenceSnapshot::release(const uint32_t& sequence)
+{
+    _releasedSequence.store(sequence, std::memory_order_release);
+}
+
+void PresenceSnapshot::requestRefresh()
+{
+    _refreshRequested.store(true, std::memory_order_release);
+}
+
+bool PresenceSnapshot::refreshRequested()
+{
+    return _refreshRequested.exchange(false, std::memory_order_acq_rel);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define PRESENCE_SNAPSHOT_SIZE 3072
+#define PRESENCE_EVENT_SNAPSHOT_SIZE 1024
+
+// Double buffered text handed from one writer task to one reader task without locking.
+// The writer fills the back buffer and publishes it by incrementing the sequence number. The reader
+// releases the sequence it has finished with, the writer never reuses a buffer the reader may still hold.
+// A complete snapshot may replace one the reader hasn't taken yet. With keepUnread (for deltas, which would be
+// lost) the writer waits until the reader has released everything committed.
+class PresenceSnapshot
+{
+public:
+    explicit PresenceSnapshot(const size_t& size = PRESENCE_SNAPSHOT_SIZE, const bool& keepUnread = false);
+    virtual ~PresenceSnapshot();
+
+    // Writer side, beginWrite() returns nullptr while the reader still holds the buffer (or hasn't read it with keepUnread)
+    char* beginWrite();
+    void commit();
+    const size_t size() const;
+
+    // Reader side, acquire() returns nullptr if nothing new was committed since the last release
+    const char* acquire(uint32_t& sequence);
+    void release(const uint32_t& sequence);
+
+    // Lets the reader ask the writer for a complete snapshot, refreshRequested() clears the request
+    void requestRefresh();
+    bool refreshRequested();
+
+private:
+    char* _buffers[2] = {nullptr, nullptr};
+    size_t _size = 0;
+    bool _keepUnread = false;
+    std::atomic<uint32_t> _sequence;
+    std::atomic<uint32_t> _releasedSequence;
+    std::atomic<bool> _refreshRequested;
+};
@@ -0,0 +1,193 @@
+#include "PresenceWatchlist.h"
+#include <algorithm>
+
+void PresenceWatchlist::compile(const String& entries)
+{
+    _addressCount = 0;
+    _prefixCount = 0;
+    _uuidCount = 0;
+    _learnedCount = 0;
+    _nextLearned = 0;
+
+    const char* str = entries.c_str();
+    size_t length = entries.length();
+    size_t start = 0;
+
+    for(size_t i = 0; i <= length; i++)
+    {
+        if(i == length || str[i] == '\n' || str[i] == '\r' || str[i] == ',')
+        {
+            size_t entryStart = start;
+            size_t entryEnd = i;
+            while(entryStart < entryEnd && str[entryStart] == ' ') ++entryStart;
+            while(entryEnd > entryStart && str[entryEnd - 1] == ' ') --entryEnd;
+
+            if(entryEnd > entryStart)
+            {
+                addEntry(str + entryStart, entryEnd - entryStart);
+            }
+            start = i + 1;
+        }
+    }
+
+    std::sort(_addresses, _addresses + _addressCount);
+}
+
+void PresenceWatchlist::buildScanFilter(BleScanner::Filter& filter) const
+{
+    filter = BleScanner::Filter();
+    if(_prefixCount > 0)
+    {
+        return;
+    }
+
+    filter.addresses.assign(_addresses, _addresses + _addressCount);
+    filter.addresses.insert(filter.addresses.end(), _learned, _learned + _learnedCount);
+    if(_uuidCount > 0)
+    {
+        // Apple company id, carried by every iBeacon
+        filter.manufacturerIds.push_back(0x004C);
+    }
+}
+
+const bool PresenceWatchlist::isEmpty() const
+{
+    return _addressCount == 0 && _prefixCount == 0 && _uuidCount == 0;
+}
+
+bool PresenceWatchlist::matchesAddress(const uint64_t& address) const
+{
+    if(std::binary_search(_addresses, _addresses + _addressCount, address))
+    {
+        return true;
+    }
+
+    for(size_t i = 0; i < _learnedCount; i++)
+    {
+        if(_learned[i] == address)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PresenceWatchlist::matchesName(const char* name, const size_t& length) const
+{
+    for(size_t i = 0; i < _prefixCount; i++)
+    {
+        if(length >= _prefixLengths[i] && memcmp(name, _prefixes[i], _prefixLengths[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PresenceWatchlist::matchesBeaconUuid(const uint8_t* uuid) const
+{
+    for(size_t i = 0; i < _uuidCount; i++)
+    {
+        if(memcmp(uuid, _uuids[i], sizeof(_uuids[i])) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PresenceWatchlist::learnAddress(const uint64_t& address)
+{
+    // Oldest learned address is replaced once the list is full
+    _learned[_nextLearned] = address;
+    _nextLearned = (_nextLearned + 1) % PRESENCE_WATCHLIST_MAX_LEARNED;
+    if(_learnedCount < PRESENCE_WATCHLIST_MAX_LEARNED)
+    {
+        ++_learnedCount;
+    }
+}
+
+void PresenceWatchlist::addEntry(const char* entry, const size_t& length)
+{
+    char str[37] = {0};
+    memcpy(str, entry, std::min(length, sizeof(str) - 1));
+
+    uint64_t address = 0;
+    if(length == 17 && parseAddress(str, address))
+    {
+        if(_addressCount < PRESENCE_WATCHLIST_MAX_ADDRESSES)
+        {
+            _addresses[_addressCount] = address;
+            ++_addressCount;
+        }
+        return;
+    }
+
+    if(length == 36 && _uuidCount < PRESENCE_WATCHLIST_MAX_UUIDS && parseUuid(str, _uuids[_uuidCount]))
+    {
+        ++_uuidCount;
+        return;
+    }
+
+    if(_prefixCount < PRESENCE_WATCHLIST_MAX_PREFIXES)
+    {
+        memcpy(_prefixes[_prefixCount], str, sizeof(str));
+        _prefixLengths[_prefixCount] = strlen(str);
+        ++_prefixCount;
+    }
+}
+
+bool PresenceWatchlist::parseAddress(const char* str, uint64_t& address)
+{
+    // aa:bb:cc:dd:ee:ff, most significant byte first
+    address = 0;
+    for(int i = 0; i < 6; i++)
+    {
+        int high = hexValue(str[i * 3]);
+        int low = hexValue(str[i * 3 + 1]);
+        if(high < 0 || low < 0 || (i < 5 && str[i * 3 + 2] != ':'))
+        {
+            return false;
+        }
+        address = (address << 8) | (high << 4) | low;
+    }
+    return true;
+}
+
+bool PresenceWatchlist::parseUuid(const char* str, uint8_t* uuid)
+{
+    // 8-4-4-4-12 hex digits
+    int byteIndex = 0;
+    int i = 0;
+    while(str[i] != 0x00 && byteIndex < 16)
+    {
+        if(str[i] == '-')
+        {
+            if(i != 8 && i != 13 && i != 18 && i != 23)
+            {
+                return false;
+            }
+            ++i;
+            continue;
+        }
+
+        int high = hexValue(str[i]);
+        int low = hexValue(str[i + 1]);
+        if(high < 0 || low < 0)
+        {
+            return false;
+        }
+        uuid[byteIndex] = (high << 4) | low;
+        ++byteIndex;
+        i += 2;
+    }
+    return byteIndex == 16 && str[i] == 0x00;
+}
+
+int PresenceWatchlist::hexValue(const char& c)
+{
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include "BleInterfaces.h"
+
+#define PRESENCE_WATCHLIST_MAX_ADDRESSES 32
+#define PRESENCE_WATCHLIST_MAX_PREFIXES 8
+#define PRESENCE_WATCHLIST_MAX_UUIDS 8
+#define PRESENCE_WATCHLIST_MAX_LEARNED 32
+#define PRESENCE_WATCHLIST_MAX_SIZE 1500
+
+// Devices to track for presence detection, an empty watchlist accepts every device.
+// Entries are MAC addresses (aa:bb:cc:dd:ee:ff), iBeacon UUIDs or name prefixes, separated by newlines or commas.
+// Only used from the BLE scan callback once compiled, so no locking is needed.
+class PresenceWatchlist
+{
+public:
+    void compile(const String& entries);
+
+    const bool isEmpty() const;
+
+    bool matchesAddress(const uint64_t& address) const;
+    bool matchesName(const char* name, const size_t& length) const;
+    bool matchesBeaconUuid(const uint8_t* uuid) const; // 16 bytes, as sent in the advertisement
+
+    // Filter to let the BLE scanner drop advertisements that can't match, including the learned addresses. Stays empty
+    // if name prefixes are configured, since the name has to be checked for every advertisement.
+    void buildScanFilter(BleScanner::Filter& filter) const;
+
+    // Remembers a device matched by name or UUID, so that its advertisements without a name or beacon data pass as well.
+    // The scan filter has to be rebuilt afterwards.
+    void learnAddress(const uint64_t& address);
+
+private:
+    void addEntry(const char* entry, const size_t& length);
+    static bool parseAddress(const char* str, uint64_t& address);
+    static bool parseUuid(const char* str, uint8_t* uuid);
+    static int hexValue(const char& c);
+
+    uint64_t _addresses[PRESENCE_WATCHLIST_MAX_ADDRESSES] = {0}; // sorted
+    size_t _addressCount = 0;
+    char _prefixes[PRESENCE_WATCHLIST_MAX_PREFIXES][37] = {{0}};
+    uint8_t _prefixLengths[PRESENCE_WATCHLIST_MAX_PREFIXES] = {0};
+    size_t _prefixCount = 0;
+    uint8_t _uuids[PRESENCE_WATCHLIST_MAX_UUIDS][16] = {{0}};
+    size_t _uuidCount = 0;
+    uint64_t _learned[PRESENCE_WATCHLIST_MAX_LEARNED] = {0};
+    size_t _learnedCount = 0;
+    size_t _nextLearned = 0;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Logger.h"
+#include "EventLog.h"
+
 enum class RestartReason
 {
     RequestedViaMqtt,
@@ -42,6 +45,12 @@ inline static void restartEsp(RestartReason reason)
     }
     restartReason = (int)reason;
     restartReasonValidDetect = RESTART_REASON_VALID_DETECT;
+    if(eventLog != nullptr)
+    {
+        eventLog->record(EventId::Restart, (uint32_t)reason);
+        eventLog->flush();
+    }
+    Log->flush();
     ESP.restart();
 }
 
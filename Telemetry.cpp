@@ -0,0 +1,158 @@
+#include "Telemetry.h"
+#include <esp_heap_caps.h>
+#include <algorithm>
+
+Telemetry::Telemetry()
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+Telemetry::~Telemetry()
+{
+    vSemaphoreDelete(_mutex);
+    _mutex = nullptr;
+}
+
+HeapTelemetry Telemetry::sampleHeap()
+{
+    HeapTelemetry heap;
+    heap.freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap.minFreeHeap = esp_get_minimum_free_heap_size();
+    heap.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if(heap.freeHeap > 0)
+    {
+        heap.fragmentation = 100 - (uint8_t)((uint64_t)heap.largestFreeBlock * 100 / heap.freeHeap);
+    }
+    return heap;
+}
+
+void Telemetry::sample()
+{
+    HeapTelemetry heap = sampleHeap();
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _heap = heap;
+
+    uint32_t totalRunTime = 0;
+    // Returns 0 if there are more tasks than TELEMETRY_MAX_TASKS, the run time is 0 without run time stats
+    const UBaseType_t count = uxTaskGetSystemState(_taskStatus, TELEMETRY_MAX_TASKS, &totalRunTime);
+    const uint32_t elapsedRunTime = totalRunTime - _lastTotalRunTime;
+    const bool hasRunTime = totalRunTime > 0 && _lastTotalRunTime > 0 && elapsedRunTime > 0;
+    _lastTotalRunTime = totalRunTime;
+
+    // Match the previous sample before overwriting it, tasks are matched by number since the order can change
+    int16_t cpuLoad[TELEMETRY_MAX_TASKS];
+    for(UBaseType_t i = 0; i < count; i++)
+    {
+        cpuLoad[i] = -1;
+        for(size_t j = 0; hasRunTime && j < _taskCount; j++)
+        {
+            if(_tasks[j].number == _taskStatus[i].xTaskNumber)
+            {
+                cpuLoad[i] = (uint64_t)(_taskStatus[i].ulRunTimeCounter - _tasks[j].runTime) * 100 / elapsedRunTime;
+                break;
+            }
+        }
+    }
+
+    for(UBaseType_t i = 0; i < count; i++)
+    {
+        TaskTelemetry& task = _tasks[i];
+        strncpy(task.name, _taskStatus[i].pcTaskName, sizeof(task.name) - 1);
+        task.name[sizeof(task.name) - 1] = 0x00;
+        task.number = _taskStatus[i].xTaskNumber;
+        task.stackHighWaterMark = _taskStatus[i].usStackHighWaterMark;
+        task.runTime = _taskStatus[i].ulRunTimeCounter;
+        task.cpuLoad = cpuLoad[i];
+    }
+    _taskCount = count;
+
+    xSemaphoreGive(_mutex);
+}
+
+void Telemetry::refresh()
+{
+    HeapTelemetry heap = sampleHeap();
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _heap = heap;
+
+    const UBaseType_t count = uxTaskGetSystemState(_taskStatus, TELEMETRY_MAX_TASKS, nullptr);
+    TaskTelemetry tasks[TELEMETRY_MAX_TASKS];
+    for(UBaseType_t i = 0; i < count; i++)
+    {
+        TaskTelemetry& task = tasks[i];
+        strncpy(task.name, _taskStatus[i].pcTaskName, sizeof(task.name) - 1);
+        task.name[sizeof(task.name) - 1] = 0x00;
+        task.number = _taskStatus[i].xTaskNumber;
+        task.stackHighWaterMark = _taskStatus[i].usStackHighWaterMark;
+
+        // A task started since the last sample has all of its run time in the current period
+        for(size_t j = 0; j < _taskCount; j++)
+        {
+            if(_tasks[j].number == task.number)
+            {
+                task.runTime = _tasks[j].runTime;
+                task.cpuLoad = _tasks[j].cpuLoad;
+                break;
+            }
+        }
+    }
+    std::copy(tasks, tasks + count, _tasks);
+    _taskCount = count;
+
+    xSemaphoreGive(_mutex);
+}
+
+HeapTelemetry Telemetry::heap()
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    HeapTelemetry heap = _heap;
+    xSemaphoreGive(_mutex);
+    return heap;
+}
+
+size_t Telemetry::tasks(TaskTelemetry* tasks, const size_t& maxCount)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    size_t count = std::min(_taskCount, maxCount);
+    for(size_t i = 0; i < count; i++)
+    {
+        tasks[i] = _tasks[i];
+    }
+    xSemaphoreGive(_mutex);
+    return count;
+}
+
+void Telemetry::buildText(String& text)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+
+    text.concat("Heap: free: ");
+    text.concat(_heap.freeHeap);
+    text.concat(", min free: ");
+    text.concat(_heap.minFreeHeap);
+    text.concat(", largest block: ");
+    text.concat(_heap.largestFreeBlock);
+    text.concat(", fragmentation: ");
+    text.concat(_heap.fragmentation);
+    text.concat("%\n");
+
+    text.concat("Tasks (stack high water mark in bytes, CPU load):\n");
+    for(size_t i = 0; i < _taskCount; i++)
+    {
+        text.concat("  ");
+        text.concat(_tasks[i].name);
+        text.concat(": ");
+        text.concat(_tasks[i].stackHighWaterMark);
+        if(_tasks[i].cpuLoad >= 0)
+        {
+            text.concat(", ");
+            text.concat(_tasks[i].cpuLoad);
+            text.concat("%");
+        }
+        text.concat("\n");
+    }
+
+    xSemaphoreGive(_mutex);
+}
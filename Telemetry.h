@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define TELEMETRY_MAX_TASKS 32
+#define TELEMETRY_PUBLISH_INTERVAL 300000
+#define TELEMETRY_JSON_SIZE 3072
+
+struct TaskTelemetry
+{
+    char name[configMAX_TASK_NAME_LEN] = {0};
+    UBaseType_t number = 0;
+    uint32_t stackHighWaterMark = 0; // bytes
+    uint32_t runTime = 0; // run time counter at the last sample
+    int16_t cpuLoad = -1; // percent of one core since the previous sample, -1 if run time stats aren't available
+};
+
+struct HeapTelemetry
+{
+    uint32_t freeHeap = 0;
+    uint32_t minFreeHeap = 0;
+    uint32_t largestFreeBlock = 0;
+    uint8_t fragmentation = 0; // percent of the free heap not usable as one block
+};
+
+// Samples heap and task statistics. sample() is called by the network task, the getters copy the last sample and
+// can be called from any task.
+class Telemetry
+{
+public:
+    Telemetry();
+    virtual ~Telemetry();
+
+    // CPU load is measured from one sample() to the next
+    void sample();
+    // Updates heap and stack statistics only, keeps the CPU load of the last sample and the baseline of the next one
+    void refresh();
+
+    HeapTelemetry heap();
+    size_t tasks(TaskTelemetry* tasks, const size_t& maxCount);
+
+    void buildText(String& text);
+
+private:
+    static HeapTelemetry sampleHeap();
+
+    TaskStatus_t _taskStatus[TELEMETRY_MAX_TASKS];
+    uint32_t _lastTotalRunTime = 0;
+
+    // Used only while holding _mutex
+    SemaphoreHandle_t _mutex = nullptr;
+    HeapTelemetry _heap;
+    TaskTelemetry _tasks[TELEMETRY_MAX_TASKS];
+    size_t _taskCount = 0;
+};
@@ -6,6 +6,8 @@
 #include "Config.h"
 #include "RestartReason.h"
 #include "AccessLevel.h"
+#include "PresenceWatchlist.h"
+#include "EventLog.h"
 #include <esp_task_wdt.h>
 
 WebCfgServer::WebCfgServer(NukiWrapper* nuki, NukiOpenerWrapper* nukiOpener, Network* network, Gpio* gpio, EthServer* ethServer, Preferences* preferences, bool allowRestartToPortal)
@@ -15,6 +17,7 @@ WebCfgServer::WebCfgServer(NukiWrapper* nuki, NukiOpenerWrapper* nukiOpener, Net
   _network(network),
   _gpio(gpio),
   _preferences(preferences),
+  _httpOta(&_ota, network),
   _allowRestartToPortal(allowRestartToPortal)
 {
     _confirmCode = generateConfirmCode();
@@ -192,14 +195,13 @@ void WebCfgServer::initialize()
             return _server.requestAuthentication();
         }
 
-        if (_ota.updateStarted() && _ota.updateCompleted()) {
+        if (_ota.updateCompleted()) {
             String response = "";
             buildOtaCompletedHtml(response);
             _server.send(200, "text/html", response);
             delay(2000);
             restartEsp(RestartReason::OTACompleted);
         } else {
-            _ota.restart();
             _server.sendHeader("Location", "/ota?errored=true");
             _server.send(302, "text/plain", "");
         }
@@ -218,6 +220,12 @@ void WebCfgServer::initialize()
         buildInfoHtml(response);
         _server.send(200, "text/html", response);
     });
+    _server.on("/eventlog", [&]() {
+        if (_hasCredentials && !_server.authenticate(_credUser, _credPassword)) {
+            return _server.requestAuthentication();
+        }
+        sendEventLog();
+    });
     _server.on("/debugon", [&]() {
         _preferences->putBool(preference_publish_debug_info, true);
 
@@ -242,11 +250,6 @@ void WebCfgServer::initialize()
     });
 
     _server.begin();
-
-    _network->setKeepAliveCallback([&]()
-        {
-            update();
-        });
 }
 
 bool WebCfgServer::processArgs(String& message)
@@ -382,6 +385,21 @@ bool WebCfgServer::processArgs(String& message)
             _preferences->putBool(preference_mqtt_log_enabled, (value == "1"));
             configChanged = true;
         }
+        else if(key == "MQTTV5")
+        {
+            _preferences->putBool(preference_mqtt_v5, (value == "1"));
+            configChanged = true;
+        }
+        else if(key == "UPDCHKURL")
+        {
+            _preferences->putString(preference_update_check_url, value);
+            configChanged = true;
+        }
+        else if(key == "OTAMIRROR")
+        {
+            _preferences->putString(preference_ota_mirror_url, value);
+            configChanged = true;
+        }
         else if(key == "CHECKUPDATE")
         {
             _preferences->putBool(preference_check_updates, (value == "1"));
@@ -457,6 +475,24 @@ bool WebCfgServer::processArgs(String& message)
             _preferences->putInt(preference_presence_detection_timeout, value.toInt());
             configChanged = true;
         }
+        else if(key == "PRDDELTA")
+        {
+            _preferences->putBool(preference_presence_delta_enabled, (value == "1"));
+            configChanged = true;
+        }
+        else if(key == "PRDFULLINT")
+        {
+            _preferences->putInt(preference_presence_full_interval, value.toInt());
+            configChanged = true;
+        }
+        else if(key == "PRDWATCH")
+        {
+            if(value.length() <= PRESENCE_WATCHLIST_MAX_SIZE)
+            {
+                _preferences->putString(preference_presence_watchlist, value);
+                configChanged = true;
+            }
+        }
         else if(key == "RSBC")
         {
             _preferences->putInt(preference_restart_ble_beacon_lost, value.toInt());
@@ -566,12 +602,24 @@ void WebCfgServer::processGpioArgs()
     int count = _server.args();
 
     std::vector<PinEntry> pinConfiguration;
+    uint16_t debounceTimes[GPIO_NR_OF_PINS];
+    memset(debounceTimes, 0, sizeof(debounceTimes));
 
     for(int index = 0; index < count; index++)
     {
         String key = _server.argName(index);
         String value = _server.arg(index);
 
+        if(key.startsWith("db"))
+        {
+            int pin = key.substring(2).toInt();
+            if(pin >= 0 && pin < GPIO_NR_OF_PINS)
+            {
+                debounceTimes[pin] = std::min(std::max((int)value.toInt(), 0), UINT16_MAX);
+            }
+            continue;
+        }
+
         PinRole role = (PinRole)value.toInt();
         if(role != PinRole::Disabled)
         {
@@ -582,6 +630,14 @@ void WebCfgServer::processGpioArgs()
         }
     }
 
+    for(auto& entry : pinConfiguration)
+    {
+        if(entry.pin < GPIO_NR_OF_PINS)
+        {
+            entry.debounceTime = debounceTimes[entry.pin];
+        }
+    }
+
     _gpio->savePinConfiguration(pinConfiguration);
 }
 
@@ -750,7 +806,9 @@ void WebCfgServer::buildOtaHtml(String &response, bool errored)
         response.concat("<div>Over-the-air update errored. Please check the logs for more info</div><br/>");
     }
 
-    response.concat("<form id=\"upform\" enctype=\"multipart/form-data\" action=\"/uploadota\" method=\"POST\"><input type=\"hidden\" name=\"MAX_FILE_SIZE\" value=\"100000\" />Choose the updated nuki_hub.bin file to upload: <input name=\"uploadedfile\" type=\"file\" accept=\".bin\" /><br/>");
+    response.concat("<form id=\"upform\" enctype=\"multipart/form-data\" action=\"/uploadota\" method=\"POST\"><input type=\"hidden\" name=\"MAX_FILE_SIZE\" value=\"100000\" />");
+    response.concat("SHA-256 of the binary (optional): <input name=\"sha256\" type=\"text\" size=\"64\" maxlength=\"64\" /><br/>");
+    response.concat("Choose the updated nuki_hub.bin file to upload: <input name=\"uploadedfile\" type=\"file\" accept=\".bin\" /><br/>");
     response.concat("<br><input id=\"submitbtn\" type=\"submit\" value=\"Upload File\" /></form>");
 
     if(_preferences->getBool(preference_check_updates))
@@ -819,7 +877,10 @@ void WebCfgServer::buildMqttConfigHtml(String &response)
     printInputField(response, "NETTIMEOUT", "Network Timeout until restart (seconds; -1 to disable)", _preferences->getInt(preference_network_timeout), 5);
     printCheckBox(response, "RSTDISC", "Restart on disconnect", _preferences->getBool(preference_restart_on_disconnect));
     printCheckBox(response, "MQTTLOG", "Enable MQTT logging", _preferences->getBool(preference_mqtt_log_enabled));
+    printCheckBox(response, "MQTTV5", "Use MQTT 5 (falls back to MQTT 3.1.1 if not supported by the broker)", _preferences->getBool(preference_mqtt_v5));
     printCheckBox(response, "CHECKUPDATE", "Check for Firmware Updates every 24h", _preferences->getBool(preference_check_updates));
+    printInputField(response, "UPDCHKURL", "Firmware update check URL (empty to use the GitHub release API)", _preferences->getString(preference_update_check_url).c_str(), 200);
+    printInputField(response, "OTAMIRROR", "Firmware mirror URL for OTA updates triggered via MQTT (empty to disable)", _preferences->getString(preference_ota_mirror_url).c_str(), 200);
     response.concat("</table>");
     response.concat("* If no encryption is configured for the MQTT broker, leave empty. Only supported for WiFi connections.<br><br>");
 
@@ -875,6 +936,9 @@ void WebCfgServer::buildNukiConfigHtml(String &response)
     printCheckBox(response, "PUBAUTH", "Publish auth data (May reduce battery life)", _preferences->getBool(preference_publish_authdata));
     printCheckBox(response, "REGAPP", "Nuki Bridge is running alongside Nuki Hub (needs re-pairing if changed)", _preferences->getBool(preference_register_as_app));
     printInputField(response, "PRDTMO", "Presence detection timeout (seconds; -1 to disable)", _preferences->getInt(preference_presence_detection_timeout), 10);
+    printTextarea(response, "PRDWATCH", "Presence watchlist (MAC addresses, iBeacon UUIDs or name prefixes, one per line; empty to track all devices)", _preferences->getString(preference_presence_watchlist).c_str(), PRESENCE_WATCHLIST_MAX_SIZE, true, true);
+    printCheckBox(response, "PRDDELTA", "Publish presence changes only (enter, leave, RSSI change)", _preferences->getBool(preference_presence_delta_enabled));
+    printInputField(response, "PRDFULLINT", "Presence full list interval when publishing changes only (seconds)", _preferences->getInt(preference_presence_full_interval), 10);
     printInputField(response, "RSBC", "Restart if bluetooth beacons not received (seconds; -1 to disable)", _preferences->getInt(preference_restart_ble_beacon_lost), 10);
     response.concat("</table>");
     response.concat("<br><INPUT TYPE=SUBMIT NAME=\"submit\" VALUE=\"Save\">");
@@ -897,6 +961,7 @@ void WebCfgServer::buildGpioConfigHtml(String &response)
         String pinDesc = "Gpio " + pinStr;
 
         printDropDown(response, pinStr.c_str(), pinDesc.c_str(), getPreselectionForGpio(pin), getGpioOptions());
+        printInputField(response, ("db" + pinStr).c_str(), "Debounce time (ms, 0 = default)", getDebounceTimeForGpio(pin), 5);
     }
 
     response.concat("</table>");
@@ -985,18 +1050,33 @@ void WebCfgServer::buildInfoHtml(String &response)
     response.concat(millis() / 1000 / 60);
     response.concat(" minutes\n");
 
-    response.concat("Heap: ");
-    response.concat(esp_get_free_heap_size());
-    response.concat("\n");
+    _network->telemetry()->refresh();
+    _network->telemetry()->buildText(response);
+
+    response.concat("Event log records: ");
+    response.concat(eventLog->recordCount());
+    response.concat(eventLog->enabled() ? " (<a href=\"/eventlog\">download</a>)\n" : " (disabled)\n");
 
-    response.concat("Stack watermarks: nw: ");
-    response.concat(uxTaskGetStackHighWaterMark(networkTaskHandle));
-    response.concat(", nuki: ");
-    response.concat(uxTaskGetStackHighWaterMark(nukiTaskHandle));
-    response.concat(", pd: ");
-    response.concat(uxTaskGetStackHighWaterMark(presenceDetectionTaskHandle));
+    response.concat("Log bytes dropped: ");
+    response.concat(AsyncLog->droppedBytes());
     response.concat("\n");
 
+    if(bleScanner != nullptr)
+    {
+        const BleScanner::ScanStatistics& scanStatistics = bleScanner->getStatistics();
+        response.concat("BLE scan duty cycle: ");
+        response.concat(bleScanner->getDutyCycle() == BleScanner::DutyCycle::High ? "High" : "Low");
+        response.concat("\nBLE time (s): high duty: ");
+        response.concat((uint32_t)(scanStatistics.highDuty / 1000));
+        response.concat(", low duty: ");
+        response.concat((uint32_t)(scanStatistics.lowDuty / 1000));
+        response.concat(", connected: ");
+        response.concat((uint32_t)(scanStatistics.paused / 1000));
+        response.concat(", duty cycle switches: ");
+        response.concat(scanStatistics.dutyCycleSwitches);
+        response.concat("\n");
+    }
+
     _gpio->getConfigurationText(response, _gpio->pinConfiguration());
 
     response.concat("Restart reason FW: ");
@@ -1010,6 +1090,28 @@ void WebCfgServer::buildInfoHtml(String &response)
     response.concat("</pre> </BODY></HTML>");
 }
 
+void WebCfgServer::sendEventLog()
+{
+    // Streamed in chunks, the whole log doesn't fit into memory as text
+    _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    _server.send(200, "text/plain", "sequence;boot;uptime;event;argument\n");
+
+    EventLogRecord records[16];
+    char chunk[16 * EVENT_LOG_TEXT_LENGTH];
+    uint32_t cursor = 0;
+    size_t count;
+    while((count = eventLog->read(cursor, records, 16)) > 0)
+    {
+        size_t offset = 0;
+        for(size_t i = 0; i < count; i++)
+        {
+            offset += EventLog::format(records[i], chunk + offset, sizeof(chunk) - offset);
+        }
+        _server.sendContent(chunk, offset);
+    }
+    _server.sendContent("");
+}
+
 void WebCfgServer::processUnpair(bool opener)
 {
     String response = "";
@@ -1272,37 +1374,61 @@ void WebCfgServer::handleOtaUpload()
 
     if (upload.status == UPLOAD_FILE_START)
     {
+        _otaUploadActive = false;
+        // The update from the mirror shares _ota, it must not be interrupted by an upload
+        if(_httpOta.isRunning() || _ota.updateStarted())
+        {
+            Log->println(F("OTA: Update already in progress, upload rejected."));
+            return;
+        }
+
         String filename = upload.filename;
         if (!filename.startsWith("/"))
         {
             filename = "/" + filename;
         }
-        _otaStartTs = millis();
-        esp_task_wdt_init(30, false);
-        _network->disableAutoRestarts();
-        _network->disableMqtt();
-        if(_nuki != nullptr)
-        {
-            _nuki->disableWatchdog();
-        }
-        if(_nukiOpener != nullptr)
+        _otaProgressReportedSize = 0;
+        prepareOta();
+        Log->print("handleFileUpload Name: "); Log->println(filename);
+
+        // The digest field precedes the file in the form, so it has already been parsed
+        if(!_ota.begin(_server.arg("sha256").c_str()))
         {
-            _nukiOpener->disableWatchdog();
+            _network->publishOtaState("failed");
+            return;
         }
-        Log->print("handleFileUpload Name: "); Log->println(filename);
+        _otaUploadActive = true;
+        _network->publishOtaState("started");
     }
     else if (upload.status == UPLOAD_FILE_WRITE)
     {
-        _transferredSize = _transferredSize + upload.currentSize;
-        Log->println(_transferredSize);
-        _ota.updateFirmware(upload.buf, upload.currentSize);
+        if(!_otaUploadActive || !_ota.write(upload.buf, upload.currentSize))
+        {
+            return;
+        }
+        if(_ota.bytesWritten() - _otaProgressReportedSize >= OTA_PROGRESS_INTERVAL)
+        {
+            _otaProgressReportedSize = _ota.bytesWritten();
+            _network->publishOtaProgress(_otaProgressReportedSize);
+        }
     } else if (upload.status == UPLOAD_FILE_END)
     {
-        Log->println();
+        if(!_otaUploadActive)
+        {
+            return;
+        }
+        _otaUploadActive = false;
         Log->print("handleFileUpload Size: "); Log->println(upload.totalSize);
+        bool success = _ota.end();
+        _network->publishOtaProgress(_ota.bytesWritten());
+        _network->publishOtaState(success ? "completed" : "failed");
     }
     else if(upload.status == UPLOAD_FILE_ABORTED)
     {
+        if(!_otaUploadActive)
+        {
+            return;
+        }
         Log->println();
         Log->println("OTA aborted, restarting ESP.");
         restartEsp(RestartReason::OTAAborted);
@@ -1316,6 +1442,40 @@ void WebCfgServer::handleOtaUpload()
     }
 }
 
+void WebCfgServer::startHttpOta()
+{
+    if(millis() < 60000 || _httpOta.isRunning() || _ota.updateStarted())
+    {
+        Log->println(F("OTA: Update not possible at the moment."));
+        return;
+    }
+
+    String url = _preferences->getString(preference_ota_mirror_url);
+    if(url.length() == 0)
+    {
+        Log->println(F("OTA: No mirror URL configured."));
+        return;
+    }
+
+    prepareOta();
+    _httpOta.start(url);
+}
+
+void WebCfgServer::prepareOta()
+{
+    _otaStartTs = millis();
+    esp_task_wdt_init(30, false);
+    _network->disableAutoRestarts();
+    if(_nuki != nullptr)
+    {
+        _nuki->disableWatchdog();
+    }
+    if(_nukiOpener != nullptr)
+    {
+        _nukiOpener->disableWatchdog();
+    }
+}
+
 void WebCfgServer::sendCss()
 {
     // escaped by https://www.cescaper.com/
@@ -1368,6 +1528,21 @@ const std::vector<std::pair<String, String>> WebCfgServer::getAccessLevelOptions
     return options;
 }
 
+int WebCfgServer::getDebounceTimeForGpio(const uint8_t &pin)
+{
+    const std::vector<PinEntry>& pinConfiguration = _gpio->pinConfiguration();
+
+    for(const auto& entry : pinConfiguration)
+    {
+        if(pin == entry.pin)
+        {
+            return entry.debounceTime;
+        }
+    }
+
+    return 0;
+}
+
 String WebCfgServer::getPreselectionForGpio(const uint8_t &pin)
 {
     const std::vector<PinEntry>& pinConfiguration = _gpio->pinConfiguration();
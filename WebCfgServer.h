@@ -6,11 +6,10 @@
 #include "NetworkLock.h"
 #include "NukiOpenerWrapper.h"
 #include "Ota.h"
+#include "HttpOta.h"
 #include "Gpio.h"
 
-extern TaskHandle_t networkTaskHandle;
-extern TaskHandle_t nukiTaskHandle;
-extern TaskHandle_t presenceDetectionTaskHandle;
+extern BleScanner::Scanner* bleScanner;
 
 enum class TokenType
 {
@@ -32,6 +31,7 @@ public:
 
     void initialize();
     void update();
+    void startHttpOta();
 
 private:
     bool processArgs(String& message);
@@ -46,6 +46,7 @@ private:
     void buildConfirmHtml(String& response, const String &message, uint32_t redirectDelay = 5);
     void buildConfigureWifiHtml(String& response);
     void buildInfoHtml(String& response);
+    void sendEventLog();
     void sendCss();
     void sendFavicon();
     void processUnpair(bool opener);
@@ -62,12 +63,14 @@ private:
     const std::vector<std::pair<String, String>> getGpioOptions() const;
     const std::vector<std::pair<String, String>> getAccessLevelOptions() const;
     String getPreselectionForGpio(const uint8_t& pin);
+    int getDebounceTimeForGpio(const uint8_t& pin);
 
     void printParameter(String& response, const char* description, const char* value, const char *link = "");
 
     String generateConfirmCode();
     void waitAndProcess(const bool blocking, const uint32_t duration);
     void handleOtaUpload();
+    void prepareOta();
 
     WebServer _server;
     NukiWrapper* _nuki = nullptr;
@@ -76,6 +79,7 @@ private:
     Gpio* _gpio = nullptr;
     Preferences* _preferences = nullptr;
     Ota _ota;
+    HttpOta _httpOta;
 
     bool _hasCredentials = false;
     char _credUser[31] = {0};
@@ -83,7 +87,8 @@ private:
     bool _allowRestartToPortal = false;
     bool _pinsConfigured = false;
     bool _brokerConfigured = false;
-    uint32_t _transferredSize = 0;
+    uint32_t _otaProgressReportedSize = 0;
+    bool _otaUploadActive = false; // the browser upload owns the current update
     unsigned long _otaStartTs = 0;
     String _hostname;
 
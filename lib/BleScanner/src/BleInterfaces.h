@@ -12,13 +12,62 @@
  */
 
 #include <NimBLEDevice.h>
+#include <string>
+#include <vector>
 
 namespace BleScanner {
 
+/**
+ * @brief Fields of an advertisement, parsed once by the scanner and shared by all subscribers
+ */
+struct Advertisement {
+  Advertisement() = default;
+  explicit Advertisement(NimBLEAdvertisedDevice* advertisedDevice) {
+    address = advertisedDevice->getAddress();
+    haveManufacturerData = advertisedDevice->haveManufacturerData();
+    if (haveManufacturerData) {
+      manufacturerData = advertisedDevice->getManufacturerData();
+      haveManufacturerId = manufacturerData.length() >= 2;
+      if (haveManufacturerId) {
+        manufacturerId = (uint8_t)manufacturerData[0] | ((uint8_t)manufacturerData[1] << 8);
+      }
+    }
+  }
+
+  uint64_t address = 0; // as converted by NimBLEAddress, most significant byte first
+  bool haveManufacturerData = false;
+  bool haveManufacturerId = false;
+  uint16_t manufacturerId = 0;
+  std::string manufacturerData;
+};
+
+/**
+ * @brief Selects the advertisements forwarded to a subscriber
+ *
+ * An advertisement passes if it matches any of the entries, an empty filter passes every advertisement
+ */
+struct Filter {
+  std::vector<uint64_t> addresses;
+  std::vector<uint16_t> manufacturerIds;
+  std::vector<NimBLEUUID> serviceUuids;
+
+  bool isEmpty() const {
+    return addresses.empty() && manufacturerIds.empty() && serviceUuids.empty();
+  }
+};
 
 class Subscriber {
   public:
     virtual void onResult(NimBLEAdvertisedDevice* advertisedDevice) = 0;
+
+    /**
+     * @brief Called by the scanner for advertisements passing the subscriber's filter
+     *
+     * Override to use the fields the scanner already parsed, the default forwards to onResult()
+     */
+    virtual void onAdvertisement(NimBLEAdvertisedDevice* advertisedDevice, const Advertisement& advertisement) {
+      onResult(advertisedDevice);
+    }
 };
 
 class Publisher {
@@ -17,7 +17,9 @@
 namespace BleScanner {
 
 Scanner::Scanner(int reservedSubscribers) {
-  subscribers.reserve(reservedSubscribers);
+  subscriptions.reserve(reservedSubscribers);
+  matchingSubscribers.reserve(reservedSubscribers);
+  subscriptionsMutex = xSemaphoreCreateMutex();
 }
 
 void Scanner::initialize(const std::string& deviceName, const bool wantDuplicates, const uint16_t interval, const uint16_t window) {
@@ -29,10 +31,28 @@ void Scanner::initialize(const std::string& deviceName, const bool wantDuplicate
   bleScan->setActiveScan(true);
   bleScan->setInterval(interval);
   bleScan->setWindow(window);
+
+  highInterval = interval;
+  highWindow = window;
+  lowInterval = interval;
+  lowWindow = window;
+  dutyCycle = DutyCycle::High;
+  lastAccountingTs = millis();
 }
 
 void Scanner::update() {
-  if (!scanningEnabled || bleScan->isScanning()) {
+  accountTime();
+
+  if (!scanningEnabled) {
+    return;
+  }
+
+  DutyCycle required = requiredDutyCycle();
+  if (required != dutyCycle) {
+    applyDutyCycle(required);
+  }
+
+  if (bleScan->isScanning()) {
     return;
   }
 
@@ -48,6 +68,7 @@ void Scanner::update() {
 }
 
 void Scanner::enableScanning(bool enable) {
+  accountTime();
   scanningEnabled = enable;
   if (!enable) {
     bleScan->stop();
@@ -58,24 +79,168 @@ void Scanner::setScanDuration(const uint32_t value) {
   scanDuration = value;
 }
 
+void Scanner::setLowDutyCycle(const uint16_t interval, const uint16_t window) {
+  lowInterval = interval;
+  lowWindow = window;
+}
+
+void Scanner::setHighDutyRequired(const bool required) {
+  highDutyRequired = required;
+}
+
+void Scanner::requestHighDuty(const uint32_t duration) {
+  uint32_t until = millis() + duration;
+  if (until == 0) {
+    // 0 marks "no request"
+    until = 1;
+  }
+  uint32_t current = highDutyUntil.load();
+  // only extend, requests can arrive from different tasks
+  while ((current == 0 || (int32_t)(until - current) > 0) && !highDutyUntil.compare_exchange_weak(current, until)) {
+  }
+}
+
+DutyCycle Scanner::getDutyCycle() const {
+  return dutyCycle;
+}
+
+const ScanStatistics& Scanner::getStatistics() const {
+  return statistics;
+}
+
+DutyCycle Scanner::requiredDutyCycle() {
+  if (highDutyRequired) {
+    return DutyCycle::High;
+  }
+
+  uint32_t until = highDutyUntil.load();
+  if (until != 0) {
+    if ((int32_t)(until - millis()) > 0) {
+      return DutyCycle::High;
+    }
+    // clear the expired request so it can't turn valid again when millis() wraps
+    highDutyUntil.compare_exchange_strong(until, 0);
+  }
+  return DutyCycle::Low;
+}
+
+void Scanner::applyDutyCycle(const DutyCycle value) {
+  // interval and window only take effect when a scan is started
+  if (bleScan->isScanning()) {
+    bleScan->stop();
+  }
+
+  if (value == DutyCycle::High) {
+    bleScan->setInterval(highInterval);
+    bleScan->setWindow(highWindow);
+  } else {
+    bleScan->setInterval(lowInterval);
+    bleScan->setWindow(lowWindow);
+  }
+  dutyCycle = value;
+  statistics.dutyCycleSwitches++;
+}
+
+void Scanner::accountTime() {
+  uint32_t now = millis();
+  uint32_t elapsed = now - lastAccountingTs;
+  lastAccountingTs = now;
+
+  if (!scanningEnabled) {
+    statistics.paused += elapsed;
+  } else if (dutyCycle == DutyCycle::High) {
+    statistics.highDuty += elapsed;
+  } else {
+    statistics.lowDuty += elapsed;
+  }
+}
+
 void Scanner::subscribe(Subscriber* subscriber) {
-  if (std::find(subscribers.begin(), subscribers.end(), subscriber) != subscribers.end()) {
-    return;
+  subscribe(subscriber, Filter());
+}
+
+void Scanner::subscribe(Subscriber* subscriber, const Filter& filter) {
+  xSemaphoreTake(subscriptionsMutex, portMAX_DELAY);
+  auto it = std::find_if(subscriptions.begin(), subscriptions.end(), [subscriber](const Subscription& subscription) {
+    return subscription.subscriber == subscriber;
+  });
+  if (it == subscriptions.end()) {
+    subscriptions.push_back({subscriber, filter});
   }
-  subscribers.push_back(subscriber);
+  xSemaphoreGive(subscriptionsMutex);
 }
 
 void Scanner::unsubscribe(Subscriber* subscriber) {
-  auto it = std::find(subscribers.begin(), subscribers.end(), subscriber);
-  if (it != subscribers.end()) {
-    subscribers.erase(it);
+  xSemaphoreTake(subscriptionsMutex, portMAX_DELAY);
+  auto it = std::find_if(subscriptions.begin(), subscriptions.end(), [subscriber](const Subscription& subscription) {
+    return subscription.subscriber == subscriber;
+  });
+  if (it != subscriptions.end()) {
+    subscriptions.erase(it);
   }
+  xSemaphoreGive(subscriptionsMutex);
+}
+
+bool Scanner::setFilter(Subscriber* subscriber, const Filter& filter) {
+  bool found = false;
+  xSemaphoreTake(subscriptionsMutex, portMAX_DELAY);
+  for (auto& subscription : subscriptions) {
+    if (subscription.subscriber == subscriber) {
+      subscription.filter = filter;
+      found = true;
+      break;
+    }
+  }
+  xSemaphoreGive(subscriptionsMutex);
+  return found;
 }
 
 void Scanner::onResult(NimBLEAdvertisedDevice* advertisedDevice) {
-  for (const auto& subscriber : subscribers) {
-    subscriber->onResult(advertisedDevice);
+  const Advertisement advertisement(advertisedDevice);
+
+  // The subscribers are called without holding the mutex, so they can subscribe, unsubscribe or change filters
+  matchingSubscribers.clear();
+  xSemaphoreTake(subscriptionsMutex, portMAX_DELAY);
+  for (const auto& subscription : subscriptions) {
+    if (matches(subscription.filter, advertisedDevice, advertisement)) {
+      matchingSubscribers.push_back(subscription.subscriber);
+    }
   }
+  xSemaphoreGive(subscriptionsMutex);
+
+  for (const auto& subscriber : matchingSubscribers) {
+    subscriber->onAdvertisement(advertisedDevice, advertisement);
+  }
+}
+
+bool Scanner::matches(const Filter& filter, NimBLEAdvertisedDevice* advertisedDevice, const Advertisement& advertisement) {
+  if (filter.isEmpty()) {
+    return true;
+  }
+
+  for (const auto& address : filter.addresses) {
+    if (address == advertisement.address) {
+      return true;
+    }
+  }
+
+  if (advertisement.haveManufacturerId) {
+    for (const auto& manufacturerId : filter.manufacturerIds) {
+      if (manufacturerId == advertisement.manufacturerId) {
+        return true;
+      }
+    }
+  }
+
+  if (!filter.serviceUuids.empty() && advertisedDevice->haveServiceUUID()) {
+    for (const auto& serviceUuid : filter.serviceUuids) {
+      if (advertisedDevice->isAdvertisingService(serviceUuid)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
 }
 
 } // namespace BleScanner
@@ -15,9 +15,27 @@
 #include <string>
 #include <NimBLEDevice.h>
 #include "BleInterfaces.h"
+#include <atomic>
 
 namespace BleScanner {
 
+enum class DutyCycle {
+  Low,
+  High
+};
+
+/**
+ * @brief Accumulated time in ms the scanner spent in each state
+ *
+ * paused is the time scanning was disabled by a publisher, which is the time spent connected to a device
+ */
+struct ScanStatistics {
+  uint64_t highDuty = 0;
+  uint64_t lowDuty = 0;
+  uint64_t paused = 0;
+  uint32_t dutyCycleSwitches = 0;
+};
+
 class Scanner : public Publisher, BLEAdvertisedDeviceCallbacks {
   public:
     Scanner(int reservedSubscribers = 10);
@@ -48,6 +66,40 @@ class Scanner : public Publisher, BLEAdvertisedDeviceCallbacks {
      */
     void setScanDuration(const uint32_t value);
 
+    /**
+     * @brief Set the interval and window used while no subscriber needs continuous scanning
+     *
+     * @param interval Time in ms from the start of a window until the start of the next window
+     * @param window time in ms to scan
+     *
+     * Setting the same values as passed to initialize() disables the adaptive duty cycle
+     */
+    void setLowDutyCycle(const uint16_t interval, const uint16_t window);
+
+    /**
+     * @brief Keep scanning with the high duty cycle until released, e.g. while presence detection is active
+     *
+     * @param required
+     */
+    void setHighDutyRequired(const bool required);
+
+    /**
+     * @brief Scan with the high duty cycle for the given time, e.g. while a command is pending
+     *
+     * @param duration time in ms, extends an earlier request but never shortens it
+     */
+    void requestHighDuty(const uint32_t duration);
+
+    /**
+     * @brief Returns the duty cycle currently used for scanning
+     */
+    DutyCycle getDutyCycle() const;
+
+    /**
+     * @brief Returns the time spent scanning vs. paused for connections
+     */
+    const ScanStatistics& getStatistics() const;
+
     /**
      * @brief enable/disable scanning
      *
@@ -62,26 +114,70 @@ class Scanner : public Publisher, BLEAdvertisedDeviceCallbacks {
      */
     void subscribe(Subscriber* subscriber) override;
 
+    /**
+     * @brief Subscribe to the scanner and receive only the results passing the filter
+     *
+     * @param subscriber
+     * @param filter
+     */
+    void subscribe(Subscriber* subscriber, const Filter& filter);
+
+    /**
+     * @brief Replace the filter of a subscriber
+     *
+     * @param subscriber
+     * @param filter an empty filter forwards all results
+     * @return false if the subscriber isn't subscribed
+     */
+    bool setFilter(Subscriber* subscriber, const Filter& filter);
+
     /**
      * @brief Un-Subscribe the scanner
      *
+     * A result that is being forwarded in the NimBLE host task may still reach the subscriber after this returns
+     *
      * @param subscriber
      */
     void unsubscribe(Subscriber* subscriber) override;
 
     /**
-     * @brief Forwards the scan result to the subcriber which has the onResult implemented
+     * @brief Parses the scan result once and forwards it to the subscribers whose filter it passes
      *
      * @param advertisedDevice
      */
     void onResult(NimBLEAdvertisedDevice* advertisedDevice) override;
 
   private:
+    struct Subscription {
+      Subscriber* subscriber;
+      Filter filter;
+    };
+
+    static bool matches(const Filter& filter, NimBLEAdvertisedDevice* advertisedDevice, const Advertisement& advertisement);
+    DutyCycle requiredDutyCycle();
+    void applyDutyCycle(const DutyCycle dutyCycle);
+    void accountTime();
+
     uint32_t scanDuration = 3;
     BLEScan* bleScan = nullptr;
-    std::vector<Subscriber*> subscribers;
+    std::vector<Subscription> subscriptions;
+    // onResult() runs in the NimBLE host task, subscriptions are changed from other tasks
+    SemaphoreHandle_t subscriptionsMutex = nullptr;
+    // Used only by onResult()
+    std::vector<Subscriber*> matchingSubscribers;
     uint16_t scanErrors = 0;
     bool scanningEnabled = true;
+
+    uint16_t highInterval = 23;
+    uint16_t highWindow = 23;
+    uint16_t lowInterval = 23;
+    uint16_t lowWindow = 23;
+    DutyCycle dutyCycle = DutyCycle::High;
+    std::atomic<bool> highDutyRequired{false};
+    std::atomic<uint32_t> highDutyUntil{0};
+
+    ScanStatistics statistics;
+    uint32_t lastAccountingTs = 0;
 };
 
 } // namespace BleScanner
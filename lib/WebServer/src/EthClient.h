@@ -16,6 +16,7 @@ public:
     virtual size_t write(Stream &stream) = 0;
     virtual String readStringUntil(char terminator) = 0;
     virtual size_t readBytes(char *buffer, size_t length) = 0;
+    virtual size_t readBytesUntil(char terminator, char *buffer, size_t length) = 0;
     virtual IPAddress localIP() = 0;
     virtual void stop() = 0;
     virtual void flush() = 0;
@@ -20,6 +20,7 @@
 */
 
 #include <Arduino.h>
+#include <errno.h>
 #include <esp32-hal-log.h>
 #include "WiFiServer.h"
 #include "WiFiClient.h"
@@ -43,8 +44,12 @@ static const char filename[] PROGMEM = "filename";
 
 static char* readBytesWithTimeout(EthClient* client, size_t maxLength, size_t& dataLength, int timeout_ms)
 {
-  char *buf = nullptr;
+  // The body length is known from Content-Length, so allocate once instead of growing the buffer per read
+  char *buf = (char *) malloc(maxLength + 1);
   dataLength = 0;
+  if (!buf) {
+    return nullptr;
+  }
   while (dataLength < maxLength) {
     int tries = timeout_ms;
     size_t newLength;
@@ -52,31 +57,72 @@ static char* readBytesWithTimeout(EthClient* client, size_t maxLength, size_t& d
     if (!newLength) {
       break;
     }
-    if (!buf) {
-      buf = (char *) malloc(newLength + 1);
-      if (!buf) {
-        return nullptr;
-      }
+    if (newLength > maxLength - dataLength) {
+      newLength = maxLength - dataLength;
     }
-    else {
-      char* newBuf = (char *) realloc(buf, dataLength + newLength + 1);
-      if (!newBuf) {
-        free(buf);
-        return nullptr;
-      }
-      buf = newBuf;
-    }
-    client->readBytes(buf + dataLength, newLength);
-    dataLength += newLength;
-    buf[dataLength] = '\0';
+    dataLength += client->readBytes(buf + dataLength, newLength);
   }
+  buf[dataLength] = '\0';
   return buf;
 }
 
+static size_t urlDecodeInPlace(char* text)
+{
+  // decoded text is never longer than the encoded text, so decode into the same buffer
+  char* in = text;
+  char* out = text;
+  while (*in) {
+    if (*in == '%' && in[1] && in[2]) {
+      char hex[3] = { in[1], in[2], 0 };
+      *out++ = (char) strtol(hex, NULL, 16);
+      in += 3;
+    } else if (*in == '+') {
+      *out++ = ' ';
+      ++in;
+    } else {
+      *out++ = *in++;
+    }
+  }
+  *out = '\0';
+  return out - text;
+}
+
+static char* trimWhitespace(char* text)
+{
+  while (*text == ' ' || *text == '\t') ++text;
+  char* end = text + strlen(text);
+  while (end > text && (end[-1] == ' ' || end[-1] == '\t')) --end;
+  *end = '\0';
+  return text;
+}
+
+size_t WebServer::_readLine(EthClient* client, char* line, size_t maxLength) {
+  size_t len = client->readBytesUntil('\r', line, maxLength - 1);
+  line[len] = '\0';
+  if (len == maxLength - 1) {
+    // line doesn't fit into the buffer, discard the rest
+    char c;
+    while (client->readBytesUntil('\r', &c, 1) == 1);
+    log_w("Request line truncated to %u bytes", len);
+  }
+  char lf;
+  client->readBytesUntil('\n', &lf, 1);
+  return len;
+}
+
 bool WebServer::_parseRequest(EthClient* client) {
-  // Read the first line of HTTP request
-  String req = client->readStringUntil('\r');
-  client->readStringUntil('\n');
+  // The request line and the header currently parsed share the fixed request buffer, so
+  // method, path, query and header values are parsed in place without intermediate copies.
+  // The request line may use up to half of the buffer, the remainder holds one header line.
+  char* req = _requestBuffer;
+  size_t reqLength = _readLine(client, req, HTTP_REQUEST_BUFFER_SIZE / 2);
+  if (reqLength == HTTP_REQUEST_BUFFER_SIZE / 2 - 1) {
+    // don't act on a cut off path or query
+    log_e("Request line too long");
+    _contentLength = CONTENT_LENGTH_NOT_SET;
+    send(414, "text/plain", "URI Too Long");
+    return false;
+  }
   //reset header value
   for (int i = 0; i < _headerKeysCount; ++i) {
     _currentHeaders[i].value =String();
@@ -84,22 +130,22 @@ bool WebServer::_parseRequest(EthClient* client) {
 
   // First line of HTTP request looks like "GET /path HTTP/1.1"
   // Retrieve the "/path" part by finding the spaces
-  int addr_start = req.indexOf(' ');
-  int addr_end = req.indexOf(' ', addr_start + 1);
-  if (addr_start == -1 || addr_end == -1) {
-    log_e("Invalid request: %s", req.c_str());
+  char* addrStart = strchr(req, ' ');
+  char* addrEnd = addrStart != nullptr ? strchr(addrStart + 1, ' ') : nullptr;
+  if (addrStart == nullptr || addrEnd == nullptr) {
+    log_e("Invalid request: %s", req);
     return false;
   }
-
-  String methodStr = req.substring(0, addr_start);
-  String url = req.substring(addr_start + 1, addr_end);
-  String versionEnd = req.substring(addr_end + 8);
-  _currentVersion = atoi(versionEnd.c_str());
-  String searchStr = "";
-  int hasSearch = url.indexOf('?');
-  if (hasSearch != -1){
-    searchStr = url.substring(hasSearch + 1);
-    url = url.substring(0, hasSearch);
+  *addrStart = '\0';
+  *addrEnd = '\0';
+
+  const char* methodStr = req;
+  char* url = addrStart + 1;
+  _currentVersion = strlen(addrEnd + 1) >= 8 ? atoi(addrEnd + 8) : 0;
+  char* searchStr = strchr(url, '?');
+  if (searchStr != nullptr) {
+    *searchStr = '\0';
+    ++searchStr;
   }
   _currentUri = url;
   _chunked = false;
@@ -107,18 +153,18 @@ bool WebServer::_parseRequest(EthClient* client) {
   HTTPMethod method = HTTP_ANY;
   size_t num_methods = sizeof(_http_method_str) / sizeof(const char *);
   for (size_t i=0; i<num_methods; i++) {
-    if (methodStr == _http_method_str[i]) {
+    if (strcmp(methodStr, _http_method_str[i]) == 0) {
       method = (HTTPMethod)i;
       break;
     }
   }
   if (method == HTTP_ANY) {
-    log_e("Unknown HTTP Method: %s", methodStr.c_str());
+    log_e("Unknown HTTP Method: %s", methodStr);
     return false;
   }
   _currentMethod = method;
 
-  log_v("method: %s url: %s search: %s", methodStr.c_str(), url.c_str(), searchStr.c_str());
+  log_v("method: %s url: %s search: %s", methodStr, url, searchStr != nullptr ? searchStr : "");
 
   //attach handler
   RequestHandler* handler;
@@ -128,52 +174,66 @@ bool WebServer::_parseRequest(EthClient* client) {
   }
   _currentHandler = handler;
 
-  String formData;
-  // below is needed only when POST type request
-  if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE){
-    String boundaryStr;
-    String headerName;
-    String headerValue;
-    bool isForm = false;
-    bool isEncoded = false;
-    uint32_t contentLength = 0;
-    //parse headers
-    while(1){
-      req = client->readStringUntil('\r');
-      client->readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
+  char* headerLine = _requestBuffer + reqLength + 1;
+  size_t headerMaxLength = HTTP_REQUEST_BUFFER_SIZE - reqLength - 1;
+  String boundaryStr;
+  bool isForm = false;
+  bool isEncoded = false;
+  uint32_t contentLength = 0;
+  //parse headers
+  while(1){
+    _readLine(client, headerLine, headerMaxLength);
+    char* headerName = headerLine;
+    if (headerName[0] == '\0') break;//no moar headers
+    char* headerDiv = strchr(headerName, ':');
+    if (headerDiv == nullptr){
+      break;
+    }
+    *headerDiv = '\0';
+    char* headerValue = trimWhitespace(headerDiv + 1);
+    _collectHeader(headerName, headerValue);
+
+    log_v("headerName: %s", headerName);
+    log_v("headerValue: %s", headerValue);
+
+    if (strcasecmp(headerName, Content_Type) == 0){
+      using namespace mime;
+      if (strncmp(headerValue, mimeTable[txt].mimeType, strlen(mimeTable[txt].mimeType)) == 0){
+        isForm = false;
+      } else if (strncmp(headerValue, "application/x-www-form-urlencoded", 33) == 0){
+        isForm = false;
+        isEncoded = true;
+      } else if (strncmp(headerValue, "multipart/", 10) == 0){
+        const char* boundary = strchr(headerValue, '=');
+        boundaryStr = boundary != nullptr ? boundary + 1 : "";
+        boundaryStr.replace("\"","");
+        isForm = true;
       }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 1);
-      headerValue.trim();
-       _collectHeader(headerName.c_str(),headerValue.c_str());
-
-      log_v("headerName: %s", headerName.c_str());
-      log_v("headerValue: %s", headerValue.c_str());
-
-      if (headerName.equalsIgnoreCase(FPSTR(Content_Type))){
-        using namespace mime;
-        if (headerValue.startsWith(FPSTR(mimeTable[txt].mimeType))){
-          isForm = false;
-        } else if (headerValue.startsWith(F("application/x-www-form-urlencoded"))){
-          isForm = false;
-          isEncoded = true;
-        } else if (headerValue.startsWith(F("multipart/"))){
-          boundaryStr = headerValue.substring(headerValue.indexOf('=') + 1);
-          boundaryStr.replace("\"","");
-          isForm = true;
-        }
-      } else if (headerName.equalsIgnoreCase(F("Content-Length"))){
-        contentLength = headerValue.toInt();
-      } else if (headerName.equalsIgnoreCase(F("Host"))){
-        _hostHeader = headerValue;
+    } else if (strcasecmp(headerName, "Content-Length") == 0){
+      char* end = nullptr;
+      errno = 0;
+      unsigned long value = strtoul(headerValue, &end, 10);
+      if (headerValue[0] < '0' || headerValue[0] > '9' || *end != '\0' || errno == ERANGE) {
+        log_e("Invalid Content-Length: %s", headerValue);
+        _contentLength = CONTENT_LENGTH_NOT_SET;
+        send(400, "text/plain", "Bad Request");
+        return false;
       }
+      contentLength = value;
+    } else if (strcasecmp(headerName, "Host") == 0){
+      _hostHeader = headerValue;
     }
+  }
 
+  // below is needed only when POST type request
+  if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE){
     if (!isForm){
+      if (contentLength > HTTP_MAX_POST_SIZE) {
+        log_e("Request body too large: %u", (unsigned)contentLength);
+        _contentLength = CONTENT_LENGTH_NOT_SET;
+        send(413, "text/plain", "Request Entity Too Large");
+        return false;
+      }
       size_t plainLength;
       char* plainBuf = readBytesWithTimeout(client, contentLength, plainLength, HTTP_MAX_POST_WAIT);
       if (plainLength < contentLength) {
@@ -181,22 +241,20 @@ bool WebServer::_parseRequest(EthClient* client) {
       	return false;
       }
       if (contentLength > 0) {
+        log_v("Plain: %s", plainBuf);
         if(isEncoded){
           //url encoded form
-          if (searchStr != "") searchStr += '&';
-          searchStr += plainBuf;
-        }
-        _parseArguments(searchStr);
-        if(!isEncoded){
+          _parseArguments(searchStr, plainBuf);
+        } else {
+          _parseArguments(searchStr);
           //plain post json or other data
           RequestArgument& arg = _currentArgs[_currentArgCount++];
           arg.key = F("plain");
-          arg.value = String(plainBuf);
+          arg.value = plainBuf;
         }
-
-        log_v("Plain: %s", plainBuf);
         free(plainBuf);
       } else {
+        free(plainBuf);
         // No content - but we can still have arguments in the URL.
         _parseArguments(searchStr);
       }
@@ -209,34 +267,11 @@ bool WebServer::_parseRequest(EthClient* client) {
       }
     }
   } else {
-    String headerName;
-    String headerValue;
-    //parse headers
-    while(1){
-      req = client->readStringUntil('\r');
-      client->readStringUntil('\n');
-      if (req == "") break;//no moar headers
-      int headerDiv = req.indexOf(':');
-      if (headerDiv == -1){
-        break;
-      }
-      headerName = req.substring(0, headerDiv);
-      headerValue = req.substring(headerDiv + 2);
-      _collectHeader(headerName.c_str(),headerValue.c_str());
-
-	  log_v("headerName: %s", headerName.c_str());
-	  log_v("headerValue: %s", headerValue.c_str());
-
-	  if (headerName.equalsIgnoreCase("Host")){
-        _hostHeader = headerValue;
-      }
-    }
     _parseArguments(searchStr);
   }
   client->flush();
 
-  log_v("Request: %s", url.c_str());
-  log_v(" Arguments: %s", searchStr.c_str());
+  log_v("Request: %s", url);
 
   return true;
 }
@@ -251,49 +286,66 @@ bool WebServer::_collectHeader(const char* headerName, const char* headerValue)
   return false;
 }
 
-void WebServer::_parseArguments(String data) {
-  log_v("args: %s", data.c_str());
-  if (_currentArgs)
-    delete[] _currentArgs;
-  _currentArgs = 0;
-  if (data.length() == 0) {
-    _currentArgCount = 0;
-    _currentArgs = new RequestArgument[1];
-    return;
+static int countArguments(const char* data) {
+  if (data == nullptr || data[0] == '\0') {
+    return 0;
   }
-  _currentArgCount = 1;
-
-  for (int i = 0; i < (int)data.length(); ) {
-    i = data.indexOf('&', i);
-    if (i == -1)
-      break;
-    ++i;
-    ++_currentArgCount;
+  int count = 1;
+  for (const char* c = data; *c; ++c) {
+    if (*c == '&') ++count;
   }
-  log_v("args count: %d", _currentArgCount);
+  return count;
+}
 
-  _currentArgs = new RequestArgument[_currentArgCount+1];
-  int pos = 0;
-  int iarg;
-  for (iarg = 0; iarg < _currentArgCount;) {
-    int equal_sign_index = data.indexOf('=', pos);
-    int next_arg_index = data.indexOf('&', pos);
-    log_v("pos %d =@%d &@%d", pos, equal_sign_index, next_arg_index);
-    if ((equal_sign_index == -1) || ((equal_sign_index > next_arg_index) && (next_arg_index != -1))) {
+int WebServer::_appendArguments(char* data, int iarg) {
+  // splits and decodes the arguments in place, only the final key and value are copied
+  char* pos = data;
+  while (pos != nullptr && *pos) {
+    char* next = strchr(pos, '&');
+    if (next != nullptr) {
+      *next = '\0';
+      ++next;
+    }
+    char* equalSign = strchr(pos, '=');
+    if (equalSign == nullptr) {
       log_e("arg missing value: %d", iarg);
-      if (next_arg_index == -1)
-        break;
-      pos = next_arg_index + 1;
+      pos = next;
       continue;
     }
+    *equalSign = '\0';
+    urlDecodeInPlace(pos);
+    urlDecodeInPlace(equalSign + 1);
+
     RequestArgument& arg = _currentArgs[iarg];
-    arg.key = urlDecode(data.substring(pos, equal_sign_index));
-    arg.value = urlDecode(data.substring(equal_sign_index + 1, next_arg_index));
+    arg.key = pos;
+    arg.value = equalSign + 1;
     log_v("arg %d key: %s value: %s", iarg, arg.key.c_str(), arg.value.c_str());
     ++iarg;
-    if (next_arg_index == -1)
-      break;
-    pos = next_arg_index + 1;
+    pos = next;
+  }
+  return iarg;
+}
+
+void WebServer::_parseArguments(char* data, char* additionalData) {
+  log_v("args: %s", data != nullptr ? data : "");
+  if (_currentArgs)
+    delete[] _currentArgs;
+  _currentArgs = 0;
+
+  _currentArgCount = countArguments(data) + countArguments(additionalData);
+  log_v("args count: %d", _currentArgCount);
+
+  _currentArgs = new RequestArgument[_currentArgCount+1];
+  if (_currentArgCount == 0) {
+    return;
+  }
+
+  int iarg = 0;
+  if (data != nullptr) {
+    iarg = _appendArguments(data, iarg);
+  }
+  if (additionalData != nullptr) {
+    iarg = _appendArguments(additionalData, iarg);
   }
   _currentArgCount = iarg;
   log_v("args count: %d", _currentArgCount);
@@ -684,7 +684,7 @@ String WebServer::_responseCodeToString(int code) {
     case 411: return F("Length Required");
     case 412: return F("Precondition Failed");
     case 413: return F("Request Entity Too Large");
-    case 414: return F("Request-URI Too Large");
+    case 414: return F("URI Too Long");
     case 415: return F("Unsupported Media Type");
     case 416: return F("Requested range not satisfiable");
     case 417: return F("Expectation Failed");
@@ -41,6 +41,17 @@ enum HTTPAuthMethod { BASIC_AUTH, DIGEST_AUTH };
 #define HTTP_UPLOAD_BUFLEN 1436
 #endif
 
+// Holds the request line and the header line currently parsed. The request line (method, path,
+// query and version) may use half of it, i.e. up to 510 characters by default; longer request
+// lines are answered with 414 URI Too Long.
+#ifndef HTTP_REQUEST_BUFFER_SIZE
+#define HTTP_REQUEST_BUFFER_SIZE 1024
+#endif
+
+#ifndef HTTP_MAX_POST_SIZE
+#define HTTP_MAX_POST_SIZE 16384 // plain and url encoded bodies are read into memory, larger ones are rejected
+#endif
+
 #define HTTP_MAX_DATA_WAIT 5000 //ms to wait for the client to send the request
 #define HTTP_MAX_POST_WAIT 5000 //ms to wait for POST data to arrive
 #define HTTP_MAX_SEND_WAIT 5000 //ms to wait for data chunk to be ACKed
@@ -153,7 +164,9 @@ protected:
   void _handleRequest();
   void _finalizeResponse();
   bool _parseRequest(EthClient* client);
-  void _parseArguments(String data);
+  size_t _readLine(EthClient* client, char* line, size_t maxLength);
+  void _parseArguments(char* data, char* additionalData = nullptr);
+  int _appendArguments(char* data, int iarg);
   static String _responseCodeToString(int code);
   bool _parseForm(EthClient* client, String boundary, uint32_t len);
   bool _parseFormUploadAborted();
@@ -205,6 +218,8 @@ protected:
   String           _hostHeader;
   bool             _chunked;
 
+  char             _requestBuffer[HTTP_REQUEST_BUFFER_SIZE];
+
   String           _snonce;  // Store noance and opaque for future comparison
   String           _sopaque;
   String           _srealm;  // Store the Auth realm between Calls
@@ -86,6 +86,11 @@ size_t W5500EthClient::readBytes(char *buffer, size_t length)
     return _ethClient->readBytes(buffer, length);
 }
 
+size_t W5500EthClient::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+    return _ethClient->readBytesUntil(terminator, buffer, length);
+}
+
 void W5500EthClient::flush()
 {
     _ethClient->flush();
@@ -56,6 +56,11 @@ size_t WifiEthClient::readBytes(char *buffer, size_t length)
     return _wifiClient->readBytes(buffer, length);
 }
 
+size_t WifiEthClient::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+    return _wifiClient->readBytesUntil(terminator, buffer, length);
+}
+
 void WifiEthClient::flush()
 {
     _wifiClient->flush();
@@ -19,6 +19,7 @@ public:
     size_t write_P(const char *buf, size_t size) override;
     String readStringUntil(char terminator) override;
     size_t readBytes(char *buffer, size_t length) override;
+    size_t readBytesUntil(char terminator, char *buffer, size_t length) override;
     IPAddress localIP() override;
     void stop() override;
     void flush() override;
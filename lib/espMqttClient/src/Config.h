@@ -28,6 +28,9 @@ the LICENSE file.
 #define EMC_PAYLOAD_BUFFER_SIZE 32
 #endif
 
+// the SUBACK return codes have to fit in the payload buffer
+#define EMC_MAX_SUBSCRIBE_TOPICS (EMC_PAYLOAD_BUFFER_SIZE - 1)
+
 #ifndef EMC_MIN_FREE_MEMORY
 #define EMC_MIN_FREE_MEMORY 16384
 #endif
@@ -60,3 +63,15 @@ the LICENSE file.
 #ifndef EMC_USE_WATCHDOG
 #define EMC_USE_WATCHDOG 0
 #endif
+
+#ifndef EMC_MAX_TOPIC_ALIASES
+#define EMC_MAX_TOPIC_ALIASES 16
+#endif
+
+#ifndef EMC_TLS_CONNECT_TIMEOUT
+#define EMC_TLS_CONNECT_TIMEOUT 3000
+#endif
+
+#ifndef EMC_TLS_HANDSHAKE_TIMEOUT
+#define EMC_TLS_HANDSHAKE_TIMEOUT 15000
+#endif
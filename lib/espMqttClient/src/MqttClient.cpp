@@ -38,6 +38,8 @@ MqttClient::MqttClient(espMqttClientTypes::UseInternalTask useInternalTask, uint
 , _willQos(0)
 , _willRetain(false)
 , _timeout(EMC_TX_TIMEOUT)
+, _protocolVersion(4)
+, _sessionExpiryInterval(0)
 , _state(State::disconnected)
 , _generatedClientId{0}
 , _packetId(0)
@@ -53,6 +55,9 @@ MqttClient::MqttClient(espMqttClientTypes::UseInternalTask useInternalTask, uint
 , _lastServerActivity(0)
 , _pingSent(false)
 , _disconnectReason(DisconnectReason::TCP_DISCONNECTED)
+, _topicAliases{}
+, _topicAliasCount(0)
+, _serverTopicAliasMaximum(0)
 #if defined(ARDUINO_ARCH_ESP32) && ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
 , _highWaterMark(4294967295)
 #endif
@@ -75,6 +80,9 @@ MqttClient::MqttClient(espMqttClientTypes::UseInternalTask useInternalTask, uint
 MqttClient::~MqttClient() {
   disconnect(true);
   _clearQueue(2);
+  for (size_t i = 0; i < _topicAliasCount; ++i) {
+    free(_topicAliases[i].topic);
+  }
 #if defined(ARDUINO_ARCH_ESP32)
   vSemaphoreDelete(_xSemaphore);
   if (_useInternalTask == espMqttClientTypes::UseInternalTask::YES) {
@@ -109,7 +117,9 @@ bool MqttClient::connect() {
                         _willPayload,
                         _willPayloadLength,
                         (uint16_t)(_keepAlive / 1000),  // 32b to 16b doesn't overflow because it comes from 16b orignally
-                        _clientId)) {
+                        _clientId,
+                        _protocolVersion,
+                        _sessionExpiryInterval)) {
       result = true;
       _setState(State::connectingTcp1);
       #if defined(ARDUINO_ARCH_ESP32)
@@ -139,7 +149,35 @@ bool MqttClient::disconnect(bool force) {
   return false;
 }
 
+uint16_t MqttClient::subscribe(const espMqttClientTypes::SubscribeItem* list, size_t numberTopics) {
+  if (numberTopics == 0 || numberTopics > EMC_MAX_SUBSCRIBE_TOPICS) {
+    emc_log_e("Invalid number of topics to subscribe: %zu", numberTopics);
+    return 0;
+  }
+  uint16_t packetId = _getNextPacketId();
+  if (_state != State::connected) {
+    packetId = 0;
+  } else {
+    EMC_SEMAPHORE_TAKE();
+    if (!_addPacket(packetId, list, numberTopics, _protocolVersion)) {
+      emc_log_e("Could not create SUBSCRIBE packet");
+      packetId = 0;
+    }
+    EMC_SEMAPHORE_GIVE();
+  }
+  return packetId;
+}
+
 uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, const uint8_t* payload, size_t length) {
+  return publish(topic, qos, retain, payload, length, 0);
+}
+
+uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, const char* payload) {
+  size_t len = strlen(payload);
+  return publish(topic, qos, retain, reinterpret_cast<const uint8_t*>(payload), len, 0);
+}
+
+uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, const uint8_t* payload, size_t length, uint32_t messageExpiryInterval) {
   #if !EMC_ALLOW_NOT_CONNECTED_PUBLISH
   if (_state != State::connected) {
   #else
@@ -149,20 +187,19 @@ uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, const
   }
   EMC_SEMAPHORE_TAKE();
   uint16_t packetId = (qos > 0) ? _getNextPacketId() : 1;
-  if (!_addPacket(packetId, topic, payload, length, qos, retain)) {
+  espMqttClientInternals::PublishProperties properties = {0, messageExpiryInterval};
+  const char* packetTopic = _useTopicAlias(topic, &properties);
+  if (!_addPacket(packetId, packetTopic, payload, length, qos, retain, (_protocolVersion == 5) ? &properties : nullptr)) {
     emc_log_e("Could not create PUBLISH packet");
     _onError(packetId, Error::OUT_OF_MEMORY);
     packetId = 0;
+  } else if (properties.topicAlias > 0) {
+    _topicAliases[properties.topicAlias - 1].announced = true;
   }
   EMC_SEMAPHORE_GIVE();
   return packetId;
 }
 
-uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, const char* payload) {
-  size_t len = strlen(payload);
-  return publish(topic, qos, retain, reinterpret_cast<const uint8_t*>(payload), len);
-}
-
 uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, espMqttClientTypes::PayloadCallback callback, size_t length) {
   #if !EMC_ALLOW_NOT_CONNECTED_PUBLISH
   if (_state != State::connected) {
@@ -173,7 +210,9 @@ uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, espMqt
   }
   EMC_SEMAPHORE_TAKE();
   uint16_t packetId = (qos > 0) ? _getNextPacketId() : 1;
-  if (!_addPacket(packetId, topic, callback, length, qos, retain)) {
+  // no topic alias: chunked packets can't be rebuilt without the alias after a reconnect
+  espMqttClientInternals::PublishProperties properties = {0, 0};
+  if (!_addPacket(packetId, topic, callback, length, qos, retain, (_protocolVersion == 5) ? &properties : nullptr)) {
     emc_log_e("Could not create PUBLISH packet");
     _onError(packetId, Error::OUT_OF_MEMORY);
     packetId = 0;
@@ -182,6 +221,30 @@ uint16_t MqttClient::publish(const char* topic, uint8_t qos, bool retain, espMqt
   return packetId;
 }
 
+bool MqttClient::addTopicAlias(const char* topic) {
+  bool result = false;
+  EMC_SEMAPHORE_TAKE();
+  for (size_t i = 0; i < _topicAliasCount; ++i) {
+    if (strcmp(_topicAliases[i].topic, topic) == 0) {
+      EMC_SEMAPHORE_GIVE();
+      return true;
+    }
+  }
+  if (_topicAliasCount < EMC_MAX_TOPIC_ALIASES) {
+    size_t length = strlen(topic) + 1;
+    char* copy = static_cast<char*>(malloc(length));
+    if (copy) {
+      memcpy(copy, topic, length);
+      _topicAliases[_topicAliasCount].topic = copy;
+      _topicAliases[_topicAliasCount].announced = false;
+      ++_topicAliasCount;
+      result = true;
+    }
+  }
+  EMC_SEMAPHORE_GIVE();
+  return result;
+}
+
 void MqttClient::clearQueue(bool deleteSessionData) {
   _clearQueue(deleteSessionData ? 2 : 0);
 }
@@ -220,6 +283,7 @@ void MqttClient::loop() {
     case State::connectingTcp2:
       if (_transport->connected()) {
         _parser.reset();
+        _parser.setProtocolVersion(_protocolVersion);
         _lastClientActivity = _lastServerActivity = millis();
         _setState(State::connectingMqtt);
       }
@@ -323,6 +387,43 @@ uint16_t MqttClient::_getNextPacketId() {
   return _packetId;
 }
 
+const char* MqttClient::_useTopicAlias(const char* topic, espMqttClientInternals::PublishProperties* properties) {
+  // call with semaphore taken, returns the topic to put in the packet
+  if (_protocolVersion != 5 || _state != State::connected) return topic;
+  for (size_t i = 0; i < _topicAliasCount && i < _serverTopicAliasMaximum; ++i) {
+    if (strcmp(_topicAliases[i].topic, topic) == 0) {
+      properties->topicAlias = i + 1;
+      // the first packet with the alias maps the alias to the topic, following packets send an empty topic
+      return _topicAliases[i].announced ? "" : topic;
+    }
+  }
+  return topic;
+}
+
+void MqttClient::_resetTopicAliases(uint16_t topicAliasMaximum) {
+  // aliases are only valid for one connection: replace them by the topic in the packets waiting for a retry
+  EMC_SEMAPHORE_TAKE();
+  _serverTopicAliasMaximum = topicAliasMaximum;
+  for (size_t i = 0; i < _topicAliasCount; ++i) {
+    _topicAliases[i].announced = false;
+  }
+  espMqttClientInternals::Outbox<OutgoingPacket>::Iterator it = _outbox.front();
+  while (it) {
+    Packet& packet = it.get()->packet;
+    uint16_t alias = packet.topicAlias();
+    if (alias == 0 || (it.get() == _outbox.getCurrent() && _bytesSent > 0)) {
+      ++it;
+    } else if (alias <= _topicAliasCount && packet.removeTopicAlias(_topicAliases[alias - 1].topic)) {
+      ++it;
+    } else {
+      emc_log_e("Could not remove topic alias");
+      _onError(packet.packetId(), Error::OUT_OF_MEMORY);
+      _outbox.remove(it);
+    }
+  }
+  EMC_SEMAPHORE_GIVE();
+}
+
 void MqttClient::_checkOutbox() {
   while (_sendPacket() > 0) {
     if (!_advanceOutbox()) {
@@ -422,6 +523,9 @@ void MqttClient::_checkIncoming() {
           case PacketType.PINGRESP:
             _pingSent = false;
             break;
+          case PacketType.DISCONNECT:
+            _onDisconnect();
+            return;
         }
       } else if (result ==  espMqttClientInternals::ParserResult::protocolError) {
         emc_log_w("Disconnecting, protocol error");
@@ -483,6 +587,9 @@ void MqttClient::_checkTimeout() {
 void MqttClient::_onConnack() {
   if (_parser.getPacket().variableHeader.fixed.connackVarHeader.returnCode == 0x00) {
     _pingSent = false;  // reset after keepalive timeout disconnect
+    if (_protocolVersion == 5) {
+      _resetTopicAliases(_parser.getPacket().properties.topicAliasMaximum);
+    }
     _setState(State::connected);
     _advanceOutbox();
     if (_parser.getPacket().variableHeader.fixed.connackVarHeader.sessionPresent == 0) {
@@ -691,6 +798,13 @@ void MqttClient::_onUnsuback() {
   }
 }
 
+void MqttClient::_onDisconnect() {
+  // MQTT 5 only: the server closes the connection
+  emc_log_w("Disconnected by server");
+  _setState(State::disconnectingTcp1);
+  _disconnectReason = DisconnectReason::TCP_DISCONNECTED;
+}
+
 void MqttClient::_clearQueue(int clearData) {
   emc_log_i("clearing queue (clear session: %d)", clearData);
   EMC_SEMAPHORE_TAKE();
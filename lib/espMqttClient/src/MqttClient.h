@@ -36,8 +36,11 @@ class MqttClient {
     if (_state != State::connected) {
       packetId = 0;
     } else {
+      static_assert(sizeof...(Args) % 2 == 0, "Subscribe should be in topic/qos pairs");
+      const size_t numberTopics = 1 + (sizeof...(Args) / 2);
+      espMqttClientTypes::SubscribeItem list[numberTopics] = {topic, qos, args...};
       EMC_SEMAPHORE_TAKE();
-      if (!_addPacket(packetId, topic, qos, std::forward<Args>(args) ...)) {
+      if (!_addPacket(packetId, static_cast<const espMqttClientTypes::SubscribeItem*>(list), numberTopics, _protocolVersion)) {
         emc_log_e("Could not create SUBSCRIBE packet");
         packetId = 0;
       }
@@ -45,14 +48,18 @@ class MqttClient {
     }
     return packetId;
   }
+  // subscribes to all topics of the list with one SUBSCRIBE packet, at most EMC_MAX_SUBSCRIBE_TOPICS
+  uint16_t subscribe(const espMqttClientTypes::SubscribeItem* list, size_t numberTopics);
   template <typename... Args>
   uint16_t unsubscribe(const char* topic, Args&&... args) {
     uint16_t packetId = _getNextPacketId();
     if (_state != State::connected) {
       packetId = 0;
     } else {
+      const size_t numberTopics = 1 + sizeof...(Args);
+      const char* list[numberTopics] = {topic, args...};
       EMC_SEMAPHORE_TAKE();
-      if (!_addPacket(packetId, topic, std::forward<Args>(args) ...)) {
+      if (!_addPacket(packetId, static_cast<const char* const*>(list), numberTopics, _protocolVersion)) {
         emc_log_e("Could not create UNSUBSCRIBE packet");
         packetId = 0;
       }
@@ -63,6 +70,11 @@ class MqttClient {
   uint16_t publish(const char* topic, uint8_t qos, bool retain, const uint8_t* payload, size_t length);
   uint16_t publish(const char* topic, uint8_t qos, bool retain, const char* payload);
   uint16_t publish(const char* topic, uint8_t qos, bool retain, espMqttClientTypes::PayloadCallback callback, size_t length);
+  // MQTT 5 only, the message expiry interval is in seconds and ignored when connected with MQTT 3.1.1
+  uint16_t publish(const char* topic, uint8_t qos, bool retain, const uint8_t* payload, size_t length, uint32_t messageExpiryInterval);
+  // MQTT 5 only: registers a topic to be published with a topic alias, at most EMC_MAX_TOPIC_ALIASES
+  // the alias is only used when the server allows it
+  bool addTopicAlias(const char* topic);
   void clearQueue(bool deleteSessionData = false);  // Not MQTT compliant and may cause unpredictable results when `deleteSessionData` = true!
   const char* getClientId() const;
   size_t queueSize();  // No const because of mutex
@@ -96,6 +108,8 @@ class MqttClient {
   uint8_t _willQos;
   bool _willRetain;
   uint32_t _timeout;
+  uint8_t _protocolVersion;
+  uint32_t _sessionExpiryInterval;
 
   // state is protected to allow state changes by the transport system, defined in child classes
   // eg. to allow AsyncTCP
@@ -144,7 +158,18 @@ class MqttClient {
   bool _pingSent;
   espMqttClientTypes::DisconnectReason _disconnectReason;
 
+  // MQTT 5 topic aliases, alias = index + 1
+  struct TopicAlias {
+    char* topic;
+    bool announced;  // the server knows the alias on the current connection
+  };
+  TopicAlias _topicAliases[EMC_MAX_TOPIC_ALIASES];
+  size_t _topicAliasCount;
+  uint16_t _serverTopicAliasMaximum;
+
   uint16_t _getNextPacketId();
+  const char* _useTopicAlias(const char* topic, espMqttClientInternals::PublishProperties* properties);
+  void _resetTopicAliases(uint16_t topicAliasMaximum);
 
   template <typename... Args>
   bool _addPacket(Args&&... args) {
@@ -185,6 +210,7 @@ class MqttClient {
   void _onPubcomp();
   void _onSuback();
   void _onUnsuback();
+  void _onDisconnect();
 
   void _clearQueue(int clearData);  // 0: keep session,
                                     // 1: keep only PUBLISH qos > 0
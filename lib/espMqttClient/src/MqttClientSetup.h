@@ -78,6 +78,18 @@ class MqttClientSetup : public MqttClient {
     return static_cast<T&>(*this);
   }
 
+  // 4: MQTT 3.1.1 (default), 5: MQTT 5, applied on the next connect
+  T& setProtocolVersion(uint8_t protocolVersion) {
+    _protocolVersion = (protocolVersion == 5) ? 5 : 4;
+    return static_cast<T&>(*this);
+  }
+
+  // MQTT 5 only, in seconds
+  T& setSessionExpiryInterval(uint32_t sessionExpiryInterval) {
+    _sessionExpiryInterval = sessionExpiryInterval;
+    return static_cast<T&>(*this);
+  }
+
   T& onConnect(espMqttClientTypes::OnConnectCallback callback, uint32_t id = 0) {
     #if EMC_MULTIPLE_CALLBACKS
     _onConnectCallbacks.emplace_back(callback, id);
@@ -8,6 +8,8 @@ the LICENSE file.
 
 #include "Packet.h"
 
+#include <utility>  // std::swap
+
 namespace espMqttClientInternals {
 
 Packet::~Packet() {
@@ -55,6 +57,33 @@ bool Packet::removable() const {
   return false;
 }
 
+uint16_t Packet::topicAlias() const {
+  if (!_data || packetType() != PacketType.PUBLISH) return 0;
+  PublishProperties properties;
+  _parsePublishProperties(&properties);
+  return properties.topicAlias;
+}
+
+bool Packet::removeTopicAlias(const char* topic) {
+  if (!_data || packetType() != PacketType.PUBLISH || _getPayload) return false;
+  PublishProperties properties;
+  size_t payloadStart = _parsePublishProperties(&properties);
+  if (properties.topicAlias == 0) return true;
+  properties.topicAlias = 0;
+
+  uint8_t qos = (_data[0] & HeaderFlag.PUBLISH_QOSRESERVED) >> 1;
+  bool retain = _data[0] & HeaderFlag.PUBLISH_RETAIN;
+  espMqttClientTypes::Error error = espMqttClientTypes::Error::MISC_ERROR;
+  Packet packet(error, _packetId, topic, &_data[payloadStart], _size - payloadStart, qos, retain, &properties);
+  if (error != espMqttClientTypes::Error::SUCCESS) return false;
+  packet._data[0] |= _data[0] & HeaderFlag.PUBLISH_DUP;
+
+  // the old buffer is freed by the temporary packet
+  std::swap(_data, packet._data);
+  std::swap(_size, packet._size);
+  return true;
+}
+
 Packet::Packet(espMqttClientTypes::Error& error,
                bool cleanSession,
                const char* username,
@@ -65,7 +94,9 @@ Packet::Packet(espMqttClientTypes::Error& error,
                const uint8_t* willPayload,
                uint16_t willPayloadLength,
                uint16_t keepAlive,
-               const char* clientId)
+               const char* clientId,
+               uint8_t protocolVersion,
+               uint32_t sessionExpiryInterval)
 : _packetId(0)
 , _data(nullptr)
 , _size(0)
@@ -88,14 +119,19 @@ Packet::Packet(espMqttClientTypes::Error& error,
     return;
   }
 
+  // MQTT 5 properties, session expiry is the only one used
+  bool mqtt5 = protocolVersion == 5;
+  size_t propertiesLength = (sessionExpiryInterval > 0) ? 5 : 0;
+
   // Calculate size
   size_t remainingLength =
   6 +  // protocol
   1 +  // protocol level
   1 +  // connect flags
   2 +  // keepalive
+  (mqtt5 ? 1 + propertiesLength : 0) +
   2 + strlen(clientId) +
-  (willTopic ? 2 + strlen(willTopic) + 2 + willPayloadLength : 0) +
+  (willTopic ? 2 + strlen(willTopic) + 2 + willPayloadLength + (mqtt5 ? 1 : 0) : 0) +
   (username ? 2 + strlen(username) : 0) +
   (password ? 2 + strlen(password) : 0);
 
@@ -112,7 +148,7 @@ Packet::Packet(espMqttClientTypes::Error& error,
   _data[pos++] = PacketType.CONNECT | HeaderFlag.CONNECT_RESERVED;
   pos += encodeRemainingLength(remainingLength, &_data[pos]);
   pos += encodeString(PROTOCOL, &_data[pos]);
-  _data[pos++] = PROTOCOL_LEVEL;
+  _data[pos++] = mqtt5 ? PROTOCOL_LEVEL_5 : PROTOCOL_LEVEL;
   uint8_t connectFlags = 0;
   if (cleanSession) connectFlags |= espMqttClientInternals::ConnectFlag.CLEAN_SESSION;
   if (username != nullptr) connectFlags |= espMqttClientInternals::ConnectFlag.USERNAME;
@@ -135,12 +171,23 @@ Packet::Packet(espMqttClientTypes::Error& error,
   _data[pos++] = connectFlags;
   _data[pos++] = keepAlive >> 8;
   _data[pos++] = keepAlive & 0xFF;
+  if (mqtt5) {
+    _data[pos++] = propertiesLength;
+    if (sessionExpiryInterval > 0) {
+      _data[pos++] = Property.SESSION_EXPIRY_INTERVAL;
+      _data[pos++] = sessionExpiryInterval >> 24;
+      _data[pos++] = (sessionExpiryInterval >> 16) & 0xFF;
+      _data[pos++] = (sessionExpiryInterval >> 8) & 0xFF;
+      _data[pos++] = sessionExpiryInterval & 0xFF;
+    }
+  }
 
   // PAYLOAD
   // client ID
   pos += encodeString(clientId, &_data[pos]);
   // will
   if (willTopic != nullptr && willPayload != nullptr) {
+    if (mqtt5) _data[pos++] = 0;  // will properties length
     pos += encodeString(willTopic, &_data[pos]);
     _data[pos++] = willPayloadLength >> 8;
     _data[pos++] = willPayloadLength & 0xFF;
@@ -160,7 +207,8 @@ Packet::Packet(espMqttClientTypes::Error& error,
                const uint8_t* payload,
                size_t payloadLength,
                uint8_t qos,
-               bool retain)
+               bool retain,
+               const PublishProperties* properties)
 : _packetId(packetId)
 , _data(nullptr)
 , _size(0)
@@ -171,6 +219,7 @@ Packet::Packet(espMqttClientTypes::Error& error,
   size_t remainingLength =
     2 + strlen(topic) +  // topic length + topic
     2 +                  // packet ID
+    _publishPropertiesLength(properties) +
     payloadLength;
 
   if (qos == 0) {
@@ -183,7 +232,7 @@ Packet::Packet(espMqttClientTypes::Error& error,
     return;
   }
 
-  size_t pos = _fillPublishHeader(packetId, topic, remainingLength, qos, retain);
+  size_t pos = _fillPublishHeader(packetId, topic, remainingLength, qos, retain, properties);
 
   // PAYLOAD
   memcpy(&_data[pos], payload, payloadLength);
@@ -197,7 +246,8 @@ Packet::Packet(espMqttClientTypes::Error& error,
                espMqttClientTypes::PayloadCallback payloadCallback,
                size_t payloadLength,
                uint8_t qos,
-               bool retain)
+               bool retain,
+               const PublishProperties* properties)
 : _packetId(packetId)
 , _data(nullptr)
 , _size(0)
@@ -208,6 +258,7 @@ Packet::Packet(espMqttClientTypes::Error& error,
   size_t remainingLength =
     2 + strlen(topic) +  // topic length + topic
     2 +                  // packet ID
+    _publishPropertiesLength(properties) +
     payloadLength;
 
   if (qos == 0) {
@@ -220,7 +271,7 @@ Packet::Packet(espMqttClientTypes::Error& error,
     return;
   }
 
-  size_t pos = _fillPublishHeader(packetId, topic, remainingLength, qos, retain);
+  size_t pos = _fillPublishHeader(packetId, topic, remainingLength, qos, retain, properties);
 
   // payload will be added by 'Packet::available'
   _size = pos + payloadLength;
@@ -243,6 +294,28 @@ Packet::Packet(espMqttClientTypes::Error& error, uint16_t packetId, const char*
   _createSubscribe(error, list, 1);
 }
 
+Packet::Packet(espMqttClientTypes::Error& error, uint16_t packetId, const espMqttClientTypes::SubscribeItem* list, size_t numberTopics, uint8_t protocolVersion)
+: _packetId(packetId)
+, _data(nullptr)
+, _size(0)
+, _payloadIndex(0)
+, _payloadStartIndex(0)
+, _payloadEndIndex(0)
+, _getPayload(nullptr) {
+  _createSubscribe(error, list, numberTopics, protocolVersion);
+}
+
+Packet::Packet(espMqttClientTypes::Error& error, uint16_t packetId, const char* const* list, size_t numberTopics, uint8_t protocolVersion)
+: _packetId(packetId)
+, _data(nullptr)
+, _size(0)
+, _payloadIndex(0)
+, _payloadStartIndex(0)
+, _payloadEndIndex(0)
+, _getPayload(nullptr) {
+  _createUnsubscribe(error, list, numberTopics, protocolVersion);
+}
+
 Packet::Packet(espMqttClientTypes::Error& error, MQTTPacketType type, uint16_t packetId)
 : _packetId(packetId)
 , _data(nullptr)
@@ -321,7 +394,8 @@ size_t Packet::_fillPublishHeader(uint16_t packetId,
                                   const char* topic,
                                   size_t remainingLength,
                                   uint8_t qos,
-                                  bool retain) {
+                                  bool retain,
+                                  const PublishProperties* properties) {
   size_t index = 0;
 
   // FIXED HEADER
@@ -342,19 +416,73 @@ size_t Packet::_fillPublishHeader(uint16_t packetId,
     _data[index++] = packetId >> 8;
     _data[index++] = packetId & 0xFF;
   }
+  if (properties) {
+    _data[index++] = _publishPropertiesLength(properties) - 1;
+    if (properties->messageExpiryInterval > 0) {
+      _data[index++] = Property.MESSAGE_EXPIRY_INTERVAL;
+      _data[index++] = properties->messageExpiryInterval >> 24;
+      _data[index++] = (properties->messageExpiryInterval >> 16) & 0xFF;
+      _data[index++] = (properties->messageExpiryInterval >> 8) & 0xFF;
+      _data[index++] = properties->messageExpiryInterval & 0xFF;
+    }
+    if (properties->topicAlias > 0) {
+      _data[index++] = Property.TOPIC_ALIAS;
+      _data[index++] = properties->topicAlias >> 8;
+      _data[index++] = properties->topicAlias & 0xFF;
+    }
+  }
 
   return index;
 }
 
+size_t Packet::_publishPropertiesLength(const PublishProperties* properties) {
+  if (!properties) return 0;
+  return 1 +
+         (properties->messageExpiryInterval > 0 ? 5 : 0) +
+         (properties->topicAlias > 0 ? 3 : 0);
+}
+
+size_t Packet::_parsePublishProperties(PublishProperties* properties) const {
+  properties->topicAlias = 0;
+  properties->messageExpiryInterval = 0;
+
+  // fixed header: skip remaining length
+  size_t index = 1;
+  while (_data[index++] & 0x80) {}
+  // variable header: topic, packet id and properties
+  index += 2 + (static_cast<size_t>(_data[index]) << 8 | _data[index + 1]);
+  if (_data[0] & HeaderFlag.PUBLISH_QOSRESERVED) index += 2;
+  // only the properties written by _fillPublishHeader are expected, which fit in a one byte length
+  size_t end = index + 1 + _data[index];
+  ++index;
+  while (index < end) {
+    if (_data[index] == Property.TOPIC_ALIAS) {
+      properties->topicAlias = static_cast<uint16_t>(_data[index + 1]) << 8 | _data[index + 2];
+      index += 3;
+    } else if (_data[index] == Property.MESSAGE_EXPIRY_INTERVAL) {
+      properties->messageExpiryInterval = static_cast<uint32_t>(_data[index + 1]) << 24 |
+                                          static_cast<uint32_t>(_data[index + 2]) << 16 |
+                                          static_cast<uint32_t>(_data[index + 3]) << 8 |
+                                          _data[index + 4];
+      index += 5;
+    } else {
+      break;
+    }
+  }
+  return end;
+}
+
 void Packet::_createSubscribe(espMqttClientTypes::Error& error,
-                              SubscribeItem* list,
-                              size_t numberTopics) {
+                              const SubscribeItem* list,
+                              size_t numberTopics,
+                              uint8_t protocolVersion) {
   // Calculate size
   size_t payload = 0;
   for (size_t i = 0; i < numberTopics; ++i) {
     payload += 2 + strlen(list[i].topic) + 1;  // length bytes, string, qos
   }
   size_t remainingLength = 2 + payload;  // packetId + payload
+  if (protocolVersion == 5) remainingLength += 1;  // empty properties
 
   // allocate memory
   if (!_allocate(remainingLength)) {
@@ -368,6 +496,7 @@ void Packet::_createSubscribe(espMqttClientTypes::Error& error,
   pos += encodeRemainingLength(remainingLength, &_data[pos]);
   _data[pos++] = _packetId >> 8;
   _data[pos++] = _packetId & 0xFF;
+  if (protocolVersion == 5) _data[pos++] = 0;
   for (size_t i = 0; i < numberTopics; ++i) {
     pos += encodeString(list[i].topic, &_data[pos]);
     _data[pos++] = list[i].qos;
@@ -377,14 +506,16 @@ void Packet::_createSubscribe(espMqttClientTypes::Error& error,
 }
 
 void Packet::_createUnsubscribe(espMqttClientTypes::Error& error,
-                                const char** list,
-                                size_t numberTopics) {
+                                const char* const* list,
+                                size_t numberTopics,
+                                uint8_t protocolVersion) {
   // Calculate size
   size_t payload = 0;
   for (size_t i = 0; i < numberTopics; ++i) {
     payload += 2 + strlen(list[i]);  // length bytes, string
   }
   size_t remainingLength = 2 + payload;  // packetId + payload
+  if (protocolVersion == 5) remainingLength += 1;  // empty properties
 
   // allocate memory
   if (!_allocate(remainingLength)) {
@@ -398,6 +529,7 @@ void Packet::_createUnsubscribe(espMqttClientTypes::Error& error,
   pos += encodeRemainingLength(remainingLength, &_data[pos]);
   _data[pos++] = _packetId >> 8;
   _data[pos++] = _packetId & 0xFF;
+  if (protocolVersion == 5) _data[pos++] = 0;
   for (size_t i = 0; i < numberTopics; ++i) {
     pos += encodeString(list[i], &_data[pos]);
   }
@@ -21,6 +21,12 @@ the LICENSE file.
 
 namespace espMqttClientInternals {
 
+// MQTT 5 PUBLISH properties, 0 if not used
+struct PublishProperties {
+  uint16_t topicAlias;
+  uint32_t messageExpiryInterval;  // seconds
+};
+
 class Packet {
  public:
   ~Packet();
@@ -33,6 +39,11 @@ class Packet {
   MQTTPacketType packetType() const;
   bool removable() const;
 
+  // MQTT 5 only: topic alias of a PUBLISH packet, 0 if none
+  uint16_t topicAlias() const;
+  // MQTT 5 only: rebuilds a PUBLISH packet with the full topic and without topic alias
+  bool removeTopicAlias(const char* topic);
+
  protected:
   uint16_t _packetId;  // save as separate variable: will be accessed frequently
   uint8_t* _data;
@@ -44,10 +55,7 @@ class Packet {
   size_t _payloadEndIndex;
   espMqttClientTypes::PayloadCallback _getPayload;
 
-  struct SubscribeItem {
-    const char* topic;
-    uint8_t qos;
-  };
+  typedef espMqttClientTypes::SubscribeItem SubscribeItem;
 
  public:
   // CONNECT
@@ -61,7 +69,9 @@ class Packet {
          const uint8_t* willPayload,
          uint16_t willPayloadLength,
          uint16_t keepAlive,
-         const char* clientId);
+         const char* clientId,
+         uint8_t protocolVersion = 4,
+         uint32_t sessionExpiryInterval = 0);
   // PUBLISH
   Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
          uint16_t packetId,
@@ -69,14 +79,16 @@ class Packet {
          const uint8_t* payload,
          size_t payloadLength,
          uint8_t qos,
-         bool retain);
+         bool retain,
+         const PublishProperties* properties = nullptr);  // properties != nullptr for MQTT 5
   Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
          uint16_t packetId,
          const char* topic,
          espMqttClientTypes::PayloadCallback payloadCallback,
          size_t payloadLength,
          uint8_t qos,
-         bool retain);
+         bool retain,
+         const PublishProperties* properties = nullptr);
   // SUBSCRIBE
   Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
          uint16_t packetId,
@@ -102,6 +114,11 @@ class Packet {
     SubscribeItem list[numberTopics] = {topic1, qos1, topic2, qos2, args...};
     _createSubscribe(error, list, numberTopics);
   }
+  Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
+         uint16_t packetId,
+         const espMqttClientTypes::SubscribeItem* list,
+         size_t numberTopics,
+         uint8_t protocolVersion = 4);
   // UNSUBSCRIBE
   Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
          uint16_t packetId,
@@ -123,6 +140,11 @@ class Packet {
     const char* list[numberTopics] = {topic1, topic2, args...};
     _createUnsubscribe(error, list, numberTopics);
   }
+  Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
+         uint16_t packetId,
+         const char* const* list,
+         size_t numberTopics,
+         uint8_t protocolVersion = 4);
   // PUBACK, PUBREC, PUBREL, PUBCOMP
   Packet(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
          MQTTPacketType type,
@@ -140,13 +162,19 @@ class Packet {
                             const char* topic,
                             size_t remainingLength,
                             uint8_t qos,
-                            bool retain);
+                            bool retain,
+                            const PublishProperties* properties);
+  static size_t _publishPropertiesLength(const PublishProperties* properties);  // including the length field
   void _createSubscribe(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
-                        SubscribeItem* list,
-                        size_t numberTopics);
+                        const SubscribeItem* list,
+                        size_t numberTopics,
+                        uint8_t protocolVersion = 4);
   void _createUnsubscribe(espMqttClientTypes::Error& error,  // NOLINT(runtime/references)
-                          const char** list,
-                          size_t numberTopics);
+                          const char* const* list,
+                          size_t numberTopics,
+                          uint8_t protocolVersion = 4);
+  // MQTT 5: offset of the first byte after the properties of a PUBLISH packet, fills the properties
+  size_t _parsePublishProperties(PublishProperties* properties) const;
 
   size_t _chunkedAvailable(size_t index);
   const uint8_t* _chunkedData(size_t index) const;
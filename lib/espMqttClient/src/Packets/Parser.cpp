@@ -8,6 +8,8 @@ the LICENSE file.
 
 #include "Parser.h"
 
+#include <cstring>  // memcpy
+
 namespace espMqttClientInternals {
 
 uint8_t IncomingPacket::qos() const {
@@ -31,6 +33,7 @@ void IncomingPacket::reset() {
   variableHeader.fixed.packetId = 0;
   payload.index = 0;
   payload.length = 0;
+  properties.topicAliasMaximum = 0;
 }
 
 Parser::Parser()
@@ -40,7 +43,14 @@ Parser::Parser()
 , _bytePos(0)
 , _parse(_fixedHeader)
 , _packet()
-, _payloadBuffer{0} {
+, _payloadBuffer{0}
+, _protocolVersion(4)
+, _skipBytes(0)
+, _propertiesRemaining(0)
+, _propertyId(0)
+, _propertyBytes(0)
+, _propertyValue(0)
+, _propertyStrings(0) {
   // empty
 }
 
@@ -68,8 +78,13 @@ void Parser::reset() {
   _packet.reset();
 }
 
+void Parser::setProtocolVersion(uint8_t protocolVersion) {
+  _protocolVersion = protocolVersion;
+}
+
 ParserResult Parser::_fixedHeader(Parser* p) {
   p->_packet.reset();
+  p->_skipBytes = 0;
   p->_packet.fixedHeader.packetType = p->_data[p->_bytesRead];
 
   // keep PUBLISH out of the switch and handle in separate if/else
@@ -87,12 +102,37 @@ ParserResult Parser::_fixedHeader(Parser* p) {
                      0x1101 --> dup, qos 2, retain
     */
     if (headerFlags <= 0x05 || headerFlags >= 0x0A) {
+      if (_publishComplete(p)) {
+        emc_log_i("Packet complete (publish %zu bytes)", p->_packet.fixedHeader.remainingLength.remainingLength);
+        return ParserResult::packet;
+      }
       p->_parse = _remainingLengthVariable;
       p->_bytePos = 0;
     } else {
       emc_log_w("Invalid packet header: 0x%02x", p->_packet.fixedHeader.packetType);
       return ParserResult::protocolError;
     }
+  } else if (p->_protocolVersion == 5) {
+    // MQTT 5 acks carry optional reason codes and properties
+    switch (p->_packet.fixedHeader.packetType) {
+      case PacketType.CONNACK | HeaderFlag.CONNACK_RESERVED:
+      case PacketType.PUBACK | HeaderFlag.PUBACK_RESERVED:
+      case PacketType.PUBREC | HeaderFlag.PUBREC_RESERVED:
+      case PacketType.PUBREL | HeaderFlag.PUBREL_RESERVED:
+      case PacketType.PUBCOMP | HeaderFlag.PUBCOMP_RESERVED:
+      case PacketType.UNSUBACK | HeaderFlag.UNSUBACK_RESERVED:
+      case PacketType.SUBACK | HeaderFlag.SUBACK_RESERVED:
+      case PacketType.DISCONNECT | HeaderFlag.DISCONNECT_RESERVED:
+        p->_parse = _remainingLengthVariable;
+        p->_bytePos = 0;
+        break;
+      case PacketType.PINGRESP | HeaderFlag.PINGRESP_RESERVED:
+        p->_parse = _remainingLengthNone;
+        break;
+      default:
+        emc_log_w("Invalid packet header: 0x%02x", p->_packet.fixedHeader.packetType);
+        return ParserResult::protocolError;
+    }
   } else {
     switch (p->_packet.fixedHeader.packetType) {
       case PacketType.CONNACK | HeaderFlag.CONNACK_RESERVED:
@@ -119,6 +159,49 @@ ParserResult Parser::_fixedHeader(Parser* p) {
   return ParserResult::awaitData;
 }
 
+// Fast path for a PUBLISH packet that is entirely in the buffer: the header is decoded in one go,
+// the topic is copied at once and the payload is passed as a view into the buffer.
+// Returns false to fall back to parsing byte by byte, which also handles the errors.
+bool Parser::_publishComplete(Parser* p) {
+  if (p->_protocolVersion == 5) return false;  // properties are parsed byte by byte
+  const uint8_t* data = &p->_data[p->_bytesRead];
+  size_t available = p->_len - p->_bytesRead;
+
+  size_t pos = 1;
+  size_t remainingLength = 0;
+  for (uint8_t i = 0; ; ++i) {
+    if (i == 4 || pos == available) return false;
+    remainingLength |= static_cast<size_t>(data[pos] & 0x7F) << (7 * i);
+    if (!(data[pos++] & 0x80)) break;
+  }
+  if (available - pos < remainingLength) return false;
+
+  size_t packetIdLength = (p->_packet.fixedHeader.packetType & (HeaderFlag.PUBLISH_QOS1 | HeaderFlag.PUBLISH_QOS2)) ? 2 : 0;
+  if (remainingLength < 2 + packetIdLength) return false;
+  size_t topicLength = static_cast<size_t>(data[pos]) << 8 | data[pos + 1];
+  if (topicLength > EMC_MAX_TOPIC_LENGTH || 2 + topicLength + packetIdLength > remainingLength) return false;
+  uint16_t packetId = 0;
+  if (packetIdLength > 0) {
+    packetId = static_cast<uint16_t>(data[pos + 2 + topicLength]) << 8 | data[pos + 3 + topicLength];
+    if (packetId == 0) return false;
+  }
+
+  p->_packet.fixedHeader.remainingLength.remainingLength = remainingLength;
+  p->_packet.variableHeader.topicLength = topicLength;
+  memcpy(p->_packet.variableHeader.topic, &data[pos + 2], topicLength);
+  p->_packet.variableHeader.topic[topicLength] = 0x00;
+  p->_packet.variableHeader.fixed.packetId = packetId;
+  pos += 2 + topicLength + packetIdLength;
+  p->_packet.payload.data = &data[pos];
+  p->_packet.payload.index = 0;
+  p->_packet.payload.length = remainingLength - 2 - topicLength - packetIdLength;
+  p->_packet.payload.total = p->_packet.payload.length;
+
+  p->_bytesRead += pos + p->_packet.payload.length - 1;  // compensate for increment in _parse-loop
+  p->_parse = _fixedHeader;
+  return true;
+}
+
 ParserResult Parser::_remainingLengthFixed(Parser* p) {
   p->_packet.fixedHeader.remainingLength.remainingLength = p->_data[p->_bytesRead];
 
@@ -151,13 +234,34 @@ ParserResult Parser::_remainingLengthVariable(Parser* p) {
   // no need to check for negative decoded length, check is already done
   p->_packet.fixedHeader.remainingLength.remainingLength = decodeRemainingLength(p->_packet.fixedHeader.remainingLength.remainingLengthRaw);
 
-  if ((p->_packet.fixedHeader.packetType & 0xF0) == PacketType.PUBLISH) {
+  uint8_t packetType = p->_packet.fixedHeader.packetType & 0xF0;
+  size_t remainingLength = p->_packet.fixedHeader.remainingLength.remainingLength;
+  if (packetType == PacketType.PUBLISH) {
     p->_parse = _varHeaderTopicLength1;
     emc_log_i("Remaining length: %zu", p->_packet.fixedHeader.remainingLength.remainingLength);
     return ParserResult::awaitData;
+  } else if (packetType == PacketType.DISCONNECT) {
+    emc_log_i("Remaining length: %zu", remainingLength);
+    if (remainingLength == 0) {
+      p->_parse = _fixedHeader;
+      return ParserResult::packet;
+    }
+    p->_skipBytes = remainingLength;
+    p->_parse = _skipRemaining;
+    return ParserResult::awaitData;
+  } else if (packetType != PacketType.SUBACK) {
+    // MQTT 5 CONNACK and acks: 2 bytes followed by an optional reason code and properties
+    if (remainingLength >= 2) {
+      p->_packet.payload.total = remainingLength - 2;
+      p->_parse = (packetType == PacketType.CONNACK) ? _varHeaderConnack1 : _varHeaderPacketId1;
+      emc_log_i("Remaining length: %zu", remainingLength);
+      return ParserResult::awaitData;
+    }
+    emc_log_w("Invalid remaining length (variable)");
   } else {
     int32_t payloadSize = p->_packet.fixedHeader.remainingLength.remainingLength - 2;  // total - packet ID
-    if (0 < payloadSize && payloadSize < EMC_PAYLOAD_BUFFER_SIZE) {
+    // MQTT 5 properties are checked when they have been parsed
+    if (0 < payloadSize && (payloadSize < EMC_PAYLOAD_BUFFER_SIZE || p->_protocolVersion == 5)) {
       p->_bytePos = 0;
       p->_packet.payload.data = p->_payloadBuffer;
       p->_packet.payload.index = 0;
@@ -200,6 +304,38 @@ ParserResult Parser::_varHeaderConnack1(Parser* p) {
 ParserResult Parser::_varHeaderConnack2(Parser* p) {
   uint8_t data = p->_data[p->_bytesRead];
   p->_parse = _fixedHeader;
+  if (p->_protocolVersion == 5) {
+    // map MQTT 5 reason codes to the closest MQTT 3.1.1 return code
+    if (data >= 0x80) {
+      switch (data) {
+        case 0x84:  // unsupported protocol version
+          data = 1;
+          break;
+        case 0x85:  // client identifier not valid
+          data = 2;
+          break;
+        case 0x86:  // bad user name or password
+          data = 4;
+          break;
+        case 0x87:  // not authorized
+          data = 5;
+          break;
+        default:
+          data = 3;  // server unavailable
+      }
+    }
+    if (data <= 5) {
+      p->_packet.variableHeader.fixed.connackVarHeader.returnCode = data;
+      if (p->_packet.payload.total > 0) {
+        p->_parse = _propertiesLength;
+        p->_bytePos = 0;
+        p->_propertiesRemaining = 0;
+        return ParserResult::awaitData;
+      }
+      emc_log_i("Packet complete");
+      return ParserResult::packet;
+    }
+  }
   if (data <= 5) {  // connect return code max is 5
     p->_packet.variableHeader.fixed.connackVarHeader.returnCode = data;
     emc_log_i("Packet complete");
@@ -221,10 +357,22 @@ ParserResult Parser::_varHeaderPacketId2(Parser* p) {
   if (p->_packet.variableHeader.fixed.packetId != 0) {
     emc_log_i("Packet variable header complete");
     if ((p->_packet.fixedHeader.packetType & 0xF0) == PacketType.SUBACK) {
+      if (p->_protocolVersion == 5) {
+        p->_parse = _propertiesLength;
+        p->_bytePos = 0;
+        p->_propertiesRemaining = 0;
+        return ParserResult::awaitData;
+      }
       p->_parse = _payloadSuback;
       return ParserResult::awaitData;
     } else if ((p->_packet.fixedHeader.packetType & 0xF0) == PacketType.PUBLISH) {
       p->_packet.payload.total -= 2;  // substract packet id length from payload
+      if (p->_protocolVersion == 5) {
+        p->_parse = _propertiesLength;
+        p->_bytePos = 0;
+        p->_propertiesRemaining = 0;
+        return ParserResult::awaitData;
+      }
       if (p->_packet.payload.total == 0) {
         p->_parse = _fixedHeader;
         return ParserResult::packet;
@@ -232,6 +380,11 @@ ParserResult Parser::_varHeaderPacketId2(Parser* p) {
         p->_parse = _payloadPublish;
       }
       return ParserResult::awaitData;
+    } else if (p->_protocolVersion == 5 && p->_packet.payload.total > 0) {
+      // MQTT 5: skip reason code(s) and properties
+      p->_skipBytes = p->_packet.payload.total;
+      p->_parse = _skipRemaining;
+      return ParserResult::awaitData;
     } else {
       return ParserResult::packet;
     }
@@ -273,6 +426,10 @@ ParserResult Parser::_varHeaderTopic(Parser* p) {
     emc_log_i("Packet variable header topic complete");
     if (p->_packet.fixedHeader.packetType & (HeaderFlag.PUBLISH_QOS1 | HeaderFlag.PUBLISH_QOS2)) {
       p->_parse = _varHeaderPacketId1;
+    } else if (p->_protocolVersion == 5) {
+      p->_parse = _propertiesLength;
+      p->_bytePos = 0;
+      p->_propertiesRemaining = 0;
     } else if (p->_packet.payload.total == 0) {
       p->_parse = _fixedHeader;
       return ParserResult::packet;
@@ -285,6 +442,7 @@ ParserResult Parser::_varHeaderTopic(Parser* p) {
 
 ParserResult Parser::_payloadSuback(Parser* p) {
   uint8_t data = p->_data[p->_bytesRead];
+  if (p->_protocolVersion == 5 && data > 0x80) data = 0x80;  // MQTT 5 failure reasons
   if (data < 0x03 || data == 0x80) {
     p->_payloadBuffer[p->_bytePos] = data;
     p->_bytePos++;
@@ -313,4 +471,191 @@ ParserResult Parser::_payloadPublish(Parser* p) {
   return ParserResult::packet;
 }
 
+ParserResult Parser::_skipRemaining(Parser* p) {
+  size_t skip = std::min(p->_len - p->_bytesRead, p->_skipBytes);
+  p->_bytesRead += skip - 1;  // compensate for increment in _parse-loop
+  p->_skipBytes -= skip;
+  if (p->_skipBytes == 0) {
+    p->_parse = _fixedHeader;
+    emc_log_i("Packet complete");
+    return ParserResult::packet;
+  }
+  return ParserResult::awaitData;
+}
+
+ParserResult Parser::_propertiesLength(Parser* p) {
+  uint8_t data = p->_data[p->_bytesRead];
+  p->_propertiesRemaining |= static_cast<size_t>(data & 0x7F) << (7 * p->_bytePos);
+  p->_bytePos++;
+  if (data & 0x80) {
+    if (p->_bytePos == 4) {
+      p->_parse = _fixedHeader;
+      emc_log_w("Invalid properties length");
+      return ParserResult::protocolError;
+    }
+    return ParserResult::awaitData;
+  }
+  size_t propertiesSize = p->_bytePos + p->_propertiesRemaining;
+  if (propertiesSize > p->_packet.payload.total) {
+    p->_parse = _fixedHeader;
+    emc_log_w("Invalid properties length: %zu", p->_propertiesRemaining);
+    return ParserResult::protocolError;
+  }
+  p->_packet.payload.total -= propertiesSize;
+  return _nextProperty(p);
+}
+
+ParserResult Parser::_propertyIdentifier(Parser* p) {
+  if (!_propertyByte(p)) return ParserResult::protocolError;
+  p->_propertyId = p->_data[p->_bytesRead];
+  p->_propertyValue = 0;
+  switch (p->_propertyId) {
+    case Property.PAYLOAD_FORMAT_INDICATOR:
+    case Property.REQUEST_PROBLEM_INFORMATION:
+    case Property.REQUEST_RESPONSE_INFORMATION:
+    case Property.MAXIMUM_QOS:
+    case Property.RETAIN_AVAILABLE:
+    case Property.WILDCARD_SUBSCRIPTION_AVAILABLE:
+    case Property.SUBSCRIPTION_IDENTIFIER_AVAILABLE:
+    case Property.SHARED_SUBSCRIPTION_AVAILABLE:
+      p->_propertyBytes = 1;
+      p->_parse = _propertyFixed;
+      break;
+    case Property.SERVER_KEEP_ALIVE:
+    case Property.RECEIVE_MAXIMUM:
+    case Property.TOPIC_ALIAS_MAXIMUM:
+    case Property.TOPIC_ALIAS:
+      p->_propertyBytes = 2;
+      p->_parse = _propertyFixed;
+      break;
+    case Property.MESSAGE_EXPIRY_INTERVAL:
+    case Property.SESSION_EXPIRY_INTERVAL:
+    case Property.WILL_DELAY_INTERVAL:
+    case Property.MAXIMUM_PACKET_SIZE:
+      p->_propertyBytes = 4;
+      p->_parse = _propertyFixed;
+      break;
+    case Property.SUBSCRIPTION_IDENTIFIER:
+      p->_parse = _propertyVarInt;
+      break;
+    case Property.CONTENT_TYPE:
+    case Property.RESPONSE_TOPIC:
+    case Property.CORRELATION_DATA:
+    case Property.ASSIGNED_CLIENT_IDENTIFIER:
+    case Property.AUTHENTICATION_METHOD:
+    case Property.AUTHENTICATION_DATA:
+    case Property.RESPONSE_INFORMATION:
+    case Property.SERVER_REFERENCE:
+    case Property.REASON_STRING:
+      p->_propertyStrings = 1;
+      p->_propertyBytes = 2;
+      p->_parse = _propertyStringLength;
+      break;
+    case Property.USER_PROPERTY:
+      p->_propertyStrings = 2;
+      p->_propertyBytes = 2;
+      p->_parse = _propertyStringLength;
+      break;
+    default:
+      p->_parse = _fixedHeader;
+      emc_log_w("Invalid property: 0x%02x", p->_propertyId);
+      return ParserResult::protocolError;
+  }
+  return ParserResult::awaitData;
+}
+
+ParserResult Parser::_propertyFixed(Parser* p) {
+  if (!_propertyByte(p)) return ParserResult::protocolError;
+  p->_propertyValue = (p->_propertyValue << 8) | p->_data[p->_bytesRead];
+  if (--p->_propertyBytes > 0) return ParserResult::awaitData;
+  if (p->_propertyId == Property.TOPIC_ALIAS_MAXIMUM) {
+    p->_packet.properties.topicAliasMaximum = p->_propertyValue;
+  }
+  return _nextProperty(p);
+}
+
+ParserResult Parser::_propertyVarInt(Parser* p) {
+  if (!_propertyByte(p)) return ParserResult::protocolError;
+  if (p->_data[p->_bytesRead] & 0x80) return ParserResult::awaitData;
+  return _nextProperty(p);
+}
+
+ParserResult Parser::_propertyStringLength(Parser* p) {
+  if (!_propertyByte(p)) return ParserResult::protocolError;
+  p->_propertyValue = (p->_propertyValue << 8) | p->_data[p->_bytesRead];
+  if (--p->_propertyBytes > 0) return ParserResult::awaitData;
+  if (p->_propertyValue > 0) {
+    p->_propertyBytes = p->_propertyValue;
+    p->_parse = _propertyString;
+    return ParserResult::awaitData;
+  }
+  if (--p->_propertyStrings > 0) {
+    p->_propertyBytes = 2;
+    p->_propertyValue = 0;
+    return ParserResult::awaitData;
+  }
+  return _nextProperty(p);
+}
+
+ParserResult Parser::_propertyString(Parser* p) {
+  if (!_propertyByte(p)) return ParserResult::protocolError;
+  if (--p->_propertyBytes > 0) return ParserResult::awaitData;
+  if (--p->_propertyStrings > 0) {
+    p->_propertyBytes = 2;
+    p->_propertyValue = 0;
+    p->_parse = _propertyStringLength;
+    return ParserResult::awaitData;
+  }
+  return _nextProperty(p);
+}
+
+bool Parser::_propertyByte(Parser* p) {
+  if (p->_propertiesRemaining == 0) {
+    p->_parse = _fixedHeader;
+    emc_log_w("Invalid property length");
+    return false;
+  }
+  --p->_propertiesRemaining;
+  return true;
+}
+
+ParserResult Parser::_nextProperty(Parser* p) {
+  if (p->_propertiesRemaining > 0) {
+    p->_parse = _propertyIdentifier;
+    return ParserResult::awaitData;
+  }
+  return _propertiesComplete(p);
+}
+
+ParserResult Parser::_propertiesComplete(Parser* p) {
+  emc_log_i("Packet properties complete");
+  uint8_t packetType = p->_packet.fixedHeader.packetType & 0xF0;
+  if (packetType == PacketType.PUBLISH) {
+    if (p->_packet.payload.total == 0) {
+      p->_parse = _fixedHeader;
+      return ParserResult::packet;
+    }
+    p->_parse = _payloadPublish;
+    return ParserResult::awaitData;
+  } else if (packetType == PacketType.SUBACK) {
+    if (0 < p->_packet.payload.total && p->_packet.payload.total < EMC_PAYLOAD_BUFFER_SIZE) {
+      p->_bytePos = 0;
+      p->_packet.payload.length = p->_packet.payload.total;
+      p->_parse = _payloadSuback;
+      return ParserResult::awaitData;
+    }
+    p->_parse = _fixedHeader;
+    emc_log_w("Invalid payload length");
+    return ParserResult::protocolError;
+  }
+  // CONNACK
+  p->_parse = _fixedHeader;
+  if (p->_packet.payload.total != 0) {
+    emc_log_w("Invalid connack length");
+    return ParserResult::protocolError;
+  }
+  emc_log_i("Packet complete");
+  return ParserResult::packet;
+}
+
 }  // end namespace espMqttClientInternals
@@ -44,6 +44,9 @@ struct IncomingPacket {
     size_t index;
     size_t total;
   } payload;
+  struct {
+    uint16_t topicAliasMaximum;  // MQTT 5 CONNACK
+  } properties;
 
   uint8_t qos() const;
   bool retain() const;
@@ -66,6 +69,7 @@ class Parser {
   ParserResult parse(const uint8_t* data, size_t len, size_t* bytesRead);
   const IncomingPacket& getPacket() const;
   void reset();
+  void setProtocolVersion(uint8_t protocolVersion);
 
  private:
   // keep data variables in class to avoid copying on every iteration of the parser
@@ -76,8 +80,17 @@ class Parser {
   ParserFunc _parse;
   IncomingPacket _packet;
   uint8_t _payloadBuffer[EMC_PAYLOAD_BUFFER_SIZE];
+  uint8_t _protocolVersion;
+  size_t _skipBytes;
+  // MQTT 5 properties
+  size_t _propertiesRemaining;
+  uint8_t _propertyId;
+  size_t _propertyBytes;
+  uint32_t _propertyValue;
+  uint8_t _propertyStrings;
 
   static ParserResult _fixedHeader(Parser* p);
+  static bool _publishComplete(Parser* p);
   static ParserResult _remainingLengthFixed(Parser* p);
   static ParserResult _remainingLengthNone(Parser* p);
   static ParserResult _remainingLengthVariable(Parser* p);
@@ -95,6 +108,18 @@ class Parser {
 
   static ParserResult _payloadSuback(Parser* p);
   static ParserResult _payloadPublish(Parser* p);
+
+  // MQTT 5
+  static ParserResult _skipRemaining(Parser* p);
+  static ParserResult _propertiesLength(Parser* p);
+  static ParserResult _propertyIdentifier(Parser* p);
+  static ParserResult _propertyFixed(Parser* p);
+  static ParserResult _propertyVarInt(Parser* p);
+  static ParserResult _propertyStringLength(Parser* p);
+  static ParserResult _propertyString(Parser* p);
+  static bool _propertyByte(Parser* p);
+  static ParserResult _nextProperty(Parser* p);
+  static ParserResult _propertiesComplete(Parser* p);
 };
 
 }  // end namespace espMqttClientInternals
@@ -0,0 +1,384 @@
+/*
+This work is licensed under the terms of the MIT license.  
+For a copy, see <https://opensource.org/licenses/MIT> or
+the LICENSE file.
+*/
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include "ClientSecureSession.h"
+
+#include <Arduino.h>  // millis, delay
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#include <mbedtls/version.h>
+
+#include "../Logging.h"
+
+namespace espMqttClientInternals {
+
+static uint32_t sessionKeyOf(const char* host, uint16_t port) {
+  // FNV-1a
+  uint32_t hash = 2166136261u;
+  for (const char* c = host; *c; ++c) {
+    hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+  }
+  hash = (hash ^ (port >> 8)) * 16777619u;
+  hash = (hash ^ (port & 0xFF)) * 16777619u;
+  return hash;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+ClientSecureSession::ClientSecureSession()
+: _caCert(nullptr)
+, _clientCert(nullptr)
+, _clientKey(nullptr)
+, _pskIdent(nullptr)
+, _psKey(nullptr)
+, _insecure(false)
+, _configReady(false)
+, _sslActive(false)
+, _connected(false)
+, _sessionValid(false)
+, _sessionKey(0) {
+  mbedtls_entropy_init(&_entropy);
+  mbedtls_ctr_drbg_init(&_drbg);
+  mbedtls_x509_crt_init(&_caChain);
+  mbedtls_x509_crt_init(&_ownCert);
+  mbedtls_pk_init(&_ownKey);
+  mbedtls_ssl_config_init(&_config);
+  mbedtls_net_init(&_socket);
+  mbedtls_ssl_session_init(&_session);
+}
+
+ClientSecureSession::~ClientSecureSession() {
+  stop();
+  _freeConfig();
+  mbedtls_ssl_session_free(&_session);
+}
+
+bool ClientSecureSession::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+bool ClientSecureSession::connect(const char* host, uint16_t port) {
+  stop();
+
+  if (!_setupConfig()) {
+    return false;
+  }
+  if (!_connectSocket(host, port)) {
+    return false;
+  }
+
+  uint32_t sessionKey = sessionKeyOf(host, port);
+  if (!_handshake(host, sessionKey)) {
+    // the broker may have forgotten the session, don't offer it again
+    clearSession();
+    stop();
+    return false;
+  }
+
+  _connected = true;
+  return true;
+}
+
+size_t ClientSecureSession::write(const uint8_t* buf, size_t size) {
+  if (!_connected) return 0;
+
+  // mbedTLS expects a write that returned WANT_WRITE to be repeated with the same data,
+  // so the record is finished here instead of returning a partial write
+  size_t written = 0;
+  uint32_t start = millis();
+  while (written < size) {
+    int ret = mbedtls_ssl_write(&_ssl, buf + written, size - written);
+    if (ret > 0) {
+      written += ret;
+    } else if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      emc_log_w("TLS write failed: -0x%04x", -ret);
+      _connected = false;
+      break;
+    } else if (millis() - start > EMC_TX_TIMEOUT) {
+      emc_log_w("TLS write timeout");
+      _connected = false;
+      break;
+    } else {
+      delay(1);
+    }
+  }
+  return written;
+}
+
+int ClientSecureSession::read(uint8_t* buf, size_t size) {
+  if (!_connected) return -1;
+
+  int ret = mbedtls_ssl_read(&_ssl, buf, size);
+  if (ret > 0) {
+    return ret;
+  }
+  if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+    return 0;
+  }
+  if (ret != 0 && ret != MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+    emc_log_w("TLS read failed: -0x%04x", -ret);
+  }
+  _connected = false;
+  return -1;
+}
+
+void ClientSecureSession::stop() {
+  if (_sslActive) {
+    if (_connected) {
+      mbedtls_ssl_close_notify(&_ssl);
+    }
+    mbedtls_ssl_free(&_ssl);
+    _sslActive = false;
+  }
+  mbedtls_net_free(&_socket);
+  _connected = false;
+}
+
+bool ClientSecureSession::connected() {
+  if (!_connected) return false;
+
+  // detect a connection closed by the peer without reading TLS data
+  uint8_t dummy;
+  int ret = recv(_socket.fd, &dummy, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (ret == 0 || (ret < 0 && errno != EWOULDBLOCK && errno != EAGAIN)) {
+    _connected = false;
+  }
+  return _connected;
+}
+
+bool ClientSecureSession::disconnected() {
+  return !_connected;
+}
+
+void ClientSecureSession::setInsecure() {
+  _freeConfig();
+  _insecure = true;
+  _caCert = nullptr;
+}
+
+void ClientSecureSession::setCACert(const char* rootCA) {
+  _freeConfig();
+  _caCert = rootCA;
+  _insecure = false;
+}
+
+void ClientSecureSession::setCertificate(const char* clientCa) {
+  _freeConfig();
+  _clientCert = clientCa;
+}
+
+void ClientSecureSession::setPrivateKey(const char* privateKey) {
+  _freeConfig();
+  _clientKey = privateKey;
+}
+
+void ClientSecureSession::setPreSharedKey(const char* pskIdent, const char* psKey) {
+  _freeConfig();
+  _pskIdent = pskIdent;
+  _psKey = psKey;
+}
+
+void ClientSecureSession::clearSession() {
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _sessionValid = false;
+}
+
+bool ClientSecureSession::_setupConfig() {
+  if (_configReady) return true;
+
+  static const char personalization[] = "espMqttClient";
+  int ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                                  reinterpret_cast<const unsigned char*>(personalization), sizeof(personalization) - 1);
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&_config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret != 0) {
+    emc_log_e("TLS setup failed: -0x%04x", -ret);
+    _freeConfig();
+    return false;
+  }
+  mbedtls_ssl_conf_rng(&_config, mbedtls_ctr_drbg_random, &_drbg);
+
+  if (_caCert) {
+    ret = mbedtls_x509_crt_parse(&_caChain, reinterpret_cast<const unsigned char*>(_caCert), strlen(_caCert) + 1);
+    if (ret != 0) {
+      emc_log_e("Could not parse CA certificate: -0x%04x", -ret);
+      _freeConfig();
+      return false;
+    }
+    mbedtls_ssl_conf_ca_chain(&_config, &_caChain, nullptr);
+    mbedtls_ssl_conf_authmode(&_config, MBEDTLS_SSL_VERIFY_REQUIRED);
+  } else if (_insecure || _pskIdent) {
+    mbedtls_ssl_conf_authmode(&_config, MBEDTLS_SSL_VERIFY_NONE);
+  } else {
+    emc_log_w("No CA certificate set, the handshake will fail");
+    mbedtls_ssl_conf_authmode(&_config, MBEDTLS_SSL_VERIFY_REQUIRED);
+  }
+
+  if (_clientCert && _clientKey) {
+    ret = mbedtls_x509_crt_parse(&_ownCert, reinterpret_cast<const unsigned char*>(_clientCert), strlen(_clientCert) + 1);
+    if (ret == 0) {
+      #if MBEDTLS_VERSION_NUMBER >= 0x03000000
+      ret = mbedtls_pk_parse_key(&_ownKey, reinterpret_cast<const unsigned char*>(_clientKey), strlen(_clientKey) + 1, nullptr, 0,
+                                 mbedtls_ctr_drbg_random, &_drbg);
+      #else
+      ret = mbedtls_pk_parse_key(&_ownKey, reinterpret_cast<const unsigned char*>(_clientKey), strlen(_clientKey) + 1, nullptr, 0);
+      #endif
+    }
+    if (ret == 0) {
+      ret = mbedtls_ssl_conf_own_cert(&_config, &_ownCert, &_ownKey);
+    }
+    if (ret != 0) {
+      emc_log_e("Could not load client certificate: -0x%04x", -ret);
+      _freeConfig();
+      return false;
+    }
+  }
+
+  if (_pskIdent && _psKey) {
+    // the key is given as hex string
+    uint8_t psk[MBEDTLS_PSK_MAX_LEN];
+    size_t pskLength = strlen(_psKey) / 2;
+    bool valid = pskLength > 0 && pskLength <= sizeof(psk) && strlen(_psKey) % 2 == 0;
+    for (size_t i = 0; valid && i < pskLength; ++i) {
+      int high = hexValue(_psKey[2 * i]);
+      int low = hexValue(_psKey[2 * i + 1]);
+      valid = high >= 0 && low >= 0;
+      psk[i] = (high << 4) | low;
+    }
+    ret = valid ? mbedtls_ssl_conf_psk(&_config, psk, pskLength, reinterpret_cast<const unsigned char*>(_pskIdent), strlen(_pskIdent)) : -1;
+    if (ret != 0) {
+      emc_log_e("Could not set pre-shared key");
+      _freeConfig();
+      return false;
+    }
+  }
+
+  _configReady = true;
+  return true;
+}
+
+void ClientSecureSession::_freeConfig() {
+  mbedtls_ssl_config_free(&_config);
+  mbedtls_pk_free(&_ownKey);
+  mbedtls_x509_crt_free(&_ownCert);
+  mbedtls_x509_crt_free(&_caChain);
+  mbedtls_ctr_drbg_free(&_drbg);
+  mbedtls_entropy_free(&_entropy);
+
+  mbedtls_entropy_init(&_entropy);
+  mbedtls_ctr_drbg_init(&_drbg);
+  mbedtls_x509_crt_init(&_caChain);
+  mbedtls_x509_crt_init(&_ownCert);
+  mbedtls_pk_init(&_ownKey);
+  mbedtls_ssl_config_init(&_config);
+
+  _configReady = false;
+}
+
+bool ClientSecureSession::_connectSocket(const char* host, uint16_t port) {
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* result = nullptr;
+  if (lwip_getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr) {
+    emc_log_e("Could not resolve %s", host);
+    return false;
+  }
+  struct sockaddr_in address = *reinterpret_cast<struct sockaddr_in*>(result->ai_addr);
+  address.sin_port = htons(port);
+  lwip_freeaddrinfo(result);
+
+  int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {
+    emc_log_e("Could not create socket");
+    return false;
+  }
+  _socket.fd = fd;
+  mbedtls_net_set_nonblock(&_socket);
+
+  // non-blocking connect to limit the time spent when the broker is unreachable
+  int ret = ::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+  if (ret < 0 && errno != EINPROGRESS) {
+    emc_log_e("Could not connect to %s", host);
+    mbedtls_net_free(&_socket);
+    return false;
+  }
+  if (ret < 0) {
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    FD_SET(fd, &writeSet);
+    struct timeval timeout;
+    timeout.tv_sec = EMC_TLS_CONNECT_TIMEOUT / 1000;
+    timeout.tv_usec = (EMC_TLS_CONNECT_TIMEOUT % 1000) * 1000;
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (select(fd + 1, nullptr, &writeSet, nullptr, &timeout) <= 0 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+      emc_log_e("Could not connect to %s", host);
+      mbedtls_net_free(&_socket);
+      return false;
+    }
+  }
+
+  int val = true;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(int));
+  return true;
+}
+
+bool ClientSecureSession::_handshake(const char* host, uint32_t sessionKey) {
+  mbedtls_ssl_init(&_ssl);
+  _sslActive = true;
+
+  int ret = mbedtls_ssl_setup(&_ssl, &_config);
+  if (ret == 0) {
+    ret = mbedtls_ssl_set_hostname(&_ssl, host);
+  }
+  if (ret != 0) {
+    emc_log_e("TLS setup failed: -0x%04x", -ret);
+    return false;
+  }
+  mbedtls_ssl_set_bio(&_ssl, &_socket, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+  if (_sessionValid && _sessionKey == sessionKey) {
+    if (mbedtls_ssl_set_session(&_ssl, &_session) != 0) {
+      clearSession();
+    }
+  }
+
+  uint32_t start = millis();
+  while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      emc_log_e("TLS handshake failed: -0x%04x", -ret);
+      return false;
+    }
+    if (millis() - start > EMC_TLS_HANDSHAKE_TIMEOUT) {
+      emc_log_e("TLS handshake timeout");
+      return false;
+    }
+    delay(10);
+  }
+
+  // keep the negotiated session for the next connection
+  clearSession();
+  if (mbedtls_ssl_get_session(&_ssl, &_session) == 0) {
+    _sessionValid = true;
+    _sessionKey = sessionKey;
+  }
+  return true;
+}
+
+}  // namespace espMqttClientInternals
+
+#endif
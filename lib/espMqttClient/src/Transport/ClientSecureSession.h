@@ -0,0 +1,81 @@
+/*
+This work is licensed under the terms of the MIT license.  
+For a copy, see <https://opensource.org/licenses/MIT> or
+the LICENSE file.
+*/
+
+#pragma once
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <IPAddress.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/pk.h>
+
+#include "Transport.h"
+#include "../Config.h"
+
+namespace espMqttClientInternals {
+
+// TLS transport using mbedTLS directly instead of WiFiClientSecure.
+// Certificates and key are parsed once on the first connection and the SSL configuration is reused.
+// The session of the last handshake is kept in RAM and offered on the next connection to the same host,
+// so a reconnect does an abbreviated handshake if the broker supports session IDs or tickets.
+// The certificate, key and PSK strings are not copied and have to outlive the client.
+class ClientSecureSession : public Transport {
+ public:
+  ClientSecureSession();
+  ~ClientSecureSession();
+  bool connect(IPAddress ip, uint16_t port) override;
+  bool connect(const char* host, uint16_t port) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int read(uint8_t* buf, size_t size) override;
+  void stop() override;
+  bool connected() override;
+  bool disconnected() override;
+
+  void setInsecure();
+  void setCACert(const char* rootCA);
+  void setCertificate(const char* clientCa);
+  void setPrivateKey(const char* privateKey);
+  void setPreSharedKey(const char* pskIdent, const char* psKey);
+  void clearSession();
+
+ private:
+  bool _setupConfig();
+  void _freeConfig();
+  bool _connectSocket(const char* host, uint16_t port);
+  bool _handshake(const char* host, uint32_t sessionKey);
+
+  const char* _caCert;
+  const char* _clientCert;
+  const char* _clientKey;
+  const char* _pskIdent;
+  const char* _psKey;
+  bool _insecure;
+  bool _configReady;
+
+  mbedtls_entropy_context _entropy;
+  mbedtls_ctr_drbg_context _drbg;
+  mbedtls_x509_crt _caChain;
+  mbedtls_x509_crt _ownCert;
+  mbedtls_pk_context _ownKey;
+  mbedtls_ssl_config _config;
+
+  mbedtls_net_context _socket;
+  mbedtls_ssl_context _ssl;
+  bool _sslActive;
+  bool _connected;
+
+  mbedtls_ssl_session _session;
+  bool _sessionValid;
+  uint32_t _sessionKey;  // hash of host and port the session belongs to
+};
+
+}  // namespace espMqttClientInternals
+
+#endif
@@ -49,6 +49,11 @@ enum class Error : uint8_t {
 
 const char* errorToString(Error error);
 
+struct SubscribeItem {
+  const char* topic;
+  uint8_t qos;
+};
+
 struct MessageProperties {
   uint8_t qos;
   bool dup;
@@ -78,27 +78,32 @@ espMqttClientSecure::espMqttClientSecure(uint8_t priority, uint8_t core)
 }
 
 espMqttClientSecure& espMqttClientSecure::setInsecure() {
-  _client.client.setInsecure();
+  _client.setInsecure();
   return *this;
 }
 
 espMqttClientSecure& espMqttClientSecure::setCACert(const char* rootCA) {
-  _client.client.setCACert(rootCA);
+  _client.setCACert(rootCA);
   return *this;
 }
 
 espMqttClientSecure& espMqttClientSecure::setCertificate(const char* clientCa) {
-  _client.client.setCertificate(clientCa);
+  _client.setCertificate(clientCa);
   return *this;
 }
 
 espMqttClientSecure& espMqttClientSecure::setPrivateKey(const char* privateKey) {
-  _client.client.setPrivateKey(privateKey);
+  _client.setPrivateKey(privateKey);
   return *this;
 }
 
 espMqttClientSecure& espMqttClientSecure::setPreSharedKey(const char* pskIdent, const char* psKey) {
-  _client.client.setPreSharedKey(pskIdent, psKey);
+  _client.setPreSharedKey(pskIdent, psKey);
+  return *this;
+}
+
+espMqttClientSecure& espMqttClientSecure::clearSession() {
+  _client.clearSession();
   return *this;
 }
 
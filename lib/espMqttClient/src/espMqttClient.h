@@ -14,6 +14,9 @@ the LICENSE file.
 #if defined(ARDUINO_ARCH_ESP8266) || defined(ARDUINO_ARCH_ESP32)
 #include "Transport/ClientSync.h"
 #include "Transport/ClientSecureSync.h"
+#if defined(ARDUINO_ARCH_ESP32)
+#include "Transport/ClientSecureSession.h"
+#endif
 #elif defined(__linux__)
 #include "Transport/ClientPosix.h"
 #endif
@@ -63,9 +66,10 @@ class espMqttClientSecure : public MqttClientSetup<espMqttClientSecure> {
   espMqttClientSecure& setCertificate(const char* clientCa);
   espMqttClientSecure& setPrivateKey(const char* privateKey);
   espMqttClientSecure& setPreSharedKey(const char* pskIdent, const char* psKey);
+  espMqttClientSecure& clearSession();
 
  protected:
-  espMqttClientInternals::ClientSecureSync _client;
+  espMqttClientInternals::ClientSecureSession _client;
 };
 #endif
 
@@ -182,6 +182,50 @@ void test_encodeConnectFail0() {
   TEST_ASSERT_EQUAL_UINT8(espMqttClientTypes::Error::MALFORMED_PARAMETER, error);
 }
 
+void test_encodeConnect5() {
+  const uint8_t check[] = {
+    0b00010000,                 // header
+    0x15,                       // remaining length
+    0x00,0x04,'M','Q','T','T',  // protocol
+    0b00000101,                 // protocol level
+    0b00000010,                 // connect flags
+    0x00,0x10,                  // keepalive (16)
+    0x05,                       // properties length
+    0x11,0x00,0x00,0x0E,0x10,   // session expiry interval (3600)
+    0x00,0x03,'c','l','i'       // client id
+  };
+  const uint32_t length = 23;
+  const char* username = nullptr;
+  const char* password = nullptr;
+  const char* willTopic = nullptr;
+  uint8_t willQoS = 0;
+  const uint8_t* willPayload = nullptr;
+  uint16_t willPayloadLength = 0;
+  uint16_t keepalive = 16;
+  uint8_t protocolVersion = 5;
+  uint32_t sessionExpiryInterval = 3600;
+  espMqttClientTypes::Error error = espMqttClientTypes::Error::MISC_ERROR;
+
+  Packet packet(error,
+                true,
+                username,
+                password,
+                willTopic,
+                false,
+                willQoS,
+                willPayload,
+                willPayloadLength,
+                keepalive,
+                "cli",
+                protocolVersion,
+                sessionExpiryInterval);
+
+  TEST_ASSERT_EQUAL_UINT8(espMqttClientTypes::Error::SUCCESS, error);
+  TEST_ASSERT_EQUAL_UINT32(length, packet.size());
+  TEST_ASSERT_EQUAL_UINT8(PacketType.CONNECT, packet.packetType());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(check, packet.data(0), length);
+}
+
 void test_encodePublish0() {
   const uint8_t check[] = {
     0b00110000,                 // header, dup, qos, retain
@@ -308,6 +352,48 @@ void test_encodePublish2() {
   TEST_ASSERT_EQUAL_UINT8_ARRAY(checkDup, packet.data(0), length);
 }
 
+void test_encodePublish5() {
+  const uint8_t check[] = {
+    0b00111010,                 // header, dup, qos, retain
+    0x11,
+    0x00,0x00,                  // topic (alias)
+    0x00,0x16,                  // packet id
+    0x08,                       // properties length
+    0x02,0x00,0x00,0x01,0x2C,   // message expiry interval (300)
+    0x23,0x00,0x01,             // topic alias
+    0x01,0x02,0x03,0x04         // payload
+  };
+  const uint32_t length = 19;
+  const uint8_t checkNoAlias[] = {
+    0b00111010,                 // header, dup, qos, retain
+    0x11,
+    0x00,0x03,'t','o','p',      // topic
+    0x00,0x16,                  // packet id
+    0x05,                       // properties length
+    0x02,0x00,0x00,0x01,0x2C,   // message expiry interval (300)
+    0x01,0x02,0x03,0x04         // payload
+  };
+  const uint32_t lengthNoAlias = 19;
+  const uint8_t payload[] = {0x01, 0x02, 0x03, 0x04};
+  espMqttClientInternals::PublishProperties properties = {1, 300};
+  uint16_t packetId = 22;
+  espMqttClientTypes::Error error = espMqttClientTypes::Error::MISC_ERROR;
+
+  Packet packet(error, packetId, "", payload, 4, 1, false, &properties);
+  packet.setDup();
+
+  TEST_ASSERT_EQUAL_UINT8(espMqttClientTypes::Error::SUCCESS, error);
+  TEST_ASSERT_EQUAL_UINT32(length, packet.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(check, packet.data(0), length);
+  TEST_ASSERT_EQUAL_UINT16(1, packet.topicAlias());
+
+  TEST_ASSERT_TRUE(packet.removeTopicAlias("top"));
+  TEST_ASSERT_EQUAL_UINT32(lengthNoAlias, packet.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(checkNoAlias, packet.data(0), lengthNoAlias);
+  TEST_ASSERT_EQUAL_UINT16(0, packet.topicAlias());
+  TEST_ASSERT_EQUAL_UINT16(packetId, packet.packetId());
+}
+
 void test_encodePubAck() {
   const uint8_t check[] = {
     0b01000000,                 // header
@@ -479,6 +565,54 @@ void test_encodeMultiSubscribe3() {
   TEST_ASSERT_EQUAL_UINT16(packetId, packet.packetId());
 }
 
+void test_encodeSubscribeList() {
+  const uint8_t check[] = {
+    0b10000010,                 // header
+    0x14,                       // remaining length
+    0x00,0x16,                  // packet Id
+    0x00, 0x03, 'a', '/', 'b',  // topic1
+    0x01,                       // qos1
+    0x00, 0x03, 'c', '/', 'd',  // topic2
+    0x02,                       // qos2
+    0x00, 0x03, 'e', '/', 'f',  // topic3
+    0x00                        // qos3
+  };
+  const uint32_t length = 22;
+  const espMqttClientTypes::SubscribeItem list[] = {{"a/b", 1}, {"c/d", 2}, {"e/f", 0}};
+  uint16_t packetId = 22;
+  espMqttClientTypes::Error error = espMqttClientTypes::Error::MISC_ERROR;
+
+  Packet packet(error, packetId, list, 3);
+  packet.setDup();  // no effect
+
+  TEST_ASSERT_EQUAL_UINT8(espMqttClientTypes::Error::SUCCESS, error);
+  TEST_ASSERT_EQUAL_UINT32(length, packet.size());
+  TEST_ASSERT_EQUAL_UINT8(PacketType.SUBSCRIBE, packet.packetType());
+  TEST_ASSERT_FALSE(packet.removable());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(check, packet.data(0), length);
+  TEST_ASSERT_EQUAL_UINT16(packetId, packet.packetId());
+}
+
+void test_encodeSubscribe5() {
+  const uint8_t check[] = {
+    0b10000010,                 // header
+    0x09,                       // remaining length
+    0x00,0x16,                  // packet Id
+    0x00,                       // properties length
+    0x00, 0x03, 'a', '/', 'b',  // topic
+    0x01                        // qos
+  };
+  const uint32_t length = 11;
+  const espMqttClientTypes::SubscribeItem list[] = {{"a/b", 1}};
+  espMqttClientTypes::Error error = espMqttClientTypes::Error::MISC_ERROR;
+
+  Packet packet(error, 22, list, 1, 5);
+
+  TEST_ASSERT_EQUAL_UINT8(espMqttClientTypes::Error::SUCCESS, error);
+  TEST_ASSERT_EQUAL_UINT32(length, packet.size());
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(check, packet.data(0), length);
+}
+
 void test_encodeUnsubscribe() {
   const uint8_t check[] = {
     0b10100010,                 // header
@@ -694,9 +828,11 @@ int main() {
   RUN_TEST(test_encodeConnect1);
   RUN_TEST(test_encodeConnect2);
   RUN_TEST(test_encodeConnectFail0);
+  RUN_TEST(test_encodeConnect5);
   RUN_TEST(test_encodePublish0);
   RUN_TEST(test_encodePublish1);
   RUN_TEST(test_encodePublish2);
+  RUN_TEST(test_encodePublish5);
   RUN_TEST(test_encodePubAck);
   RUN_TEST(test_encodePubRec);
   RUN_TEST(test_encodePubRel);
@@ -704,6 +840,8 @@ int main() {
   RUN_TEST(test_encodeSubscribe);
   RUN_TEST(test_encodeMultiSubscribe2);
   RUN_TEST(test_encodeMultiSubscribe3);
+  RUN_TEST(test_encodeSubscribeList);
+  RUN_TEST(test_encodeSubscribe5);
   RUN_TEST(test_encodeUnsubscribe);
   RUN_TEST(test_encodeMultiUnsubscribe2);
   RUN_TEST(test_encodeMultiUnsubscribe3);
@@ -336,6 +336,92 @@ void test_longStream() {
   TEST_ASSERT_FALSE(parser.getPacket().dup());
 }
 
+void test_Connack5() {
+  const uint8_t stream[] = {
+    0b00100000,                 // header
+    0x0E,                       // remaining length
+    0b00000000,                 // session present
+    0x00,                       // reason code
+    0x0B,                       // properties length
+    0x22, 0x00, 0x0A,           // topic alias maximum
+    0x26, 0x00, 0x01, 'a',      // user property
+    0x00, 0x02, 'b', 'c'
+  };
+  const size_t length = 16;
+  Parser parser5;
+  parser5.setProtocolVersion(5);
+
+  size_t bytesRead = 0;
+  ParserResult result = parser5.parse(stream, length, &bytesRead);
+
+  TEST_ASSERT_EQUAL_INT32(length, bytesRead);
+  TEST_ASSERT_EQUAL_UINT8(ParserResult::packet, result);
+  TEST_ASSERT_EQUAL_UINT8(0, parser5.getPacket().variableHeader.fixed.connackVarHeader.returnCode);
+  TEST_ASSERT_EQUAL_UINT16(10, parser5.getPacket().properties.topicAliasMaximum);
+}
+
+void test_Publish5() {
+  const uint8_t stream[] = {
+    0b00110010,                 // header
+    0x0F,                       // remaining length
+    0x00, 0x03, 'a', '/', 'b',  // topic
+    0x00, 0x0A,                 // packet id
+    0x05,                       // properties length
+    0x02, 0x00, 0x00, 0x00, 0x3C,  // message expiry interval
+    0x01, 0x02                  // payload
+  };
+  const size_t length = 17;
+  Parser parser5;
+  parser5.setProtocolVersion(5);
+
+  size_t bytesRead = 0;
+  ParserResult result = parser5.parse(stream, length, &bytesRead);
+
+  TEST_ASSERT_EQUAL_INT32(ParserResult::packet, result);
+  TEST_ASSERT_EQUAL_UINT32(length, bytesRead);
+  TEST_ASSERT_EQUAL_STRING("a/b", parser5.getPacket().variableHeader.topic);
+  TEST_ASSERT_EQUAL_UINT16(10, parser5.getPacket().variableHeader.fixed.packetId);
+  TEST_ASSERT_EQUAL_UINT32(2, parser5.getPacket().payload.length);
+  TEST_ASSERT_EQUAL_UINT32(2, parser5.getPacket().payload.total);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(&stream[15], parser5.getPacket().payload.data, 2);
+}
+
+void test_SubAck5() {
+  const uint8_t stream[] = {
+    0b10010000,
+    0x05,                       // remaining length
+    0x00, 0x0A,                 // packet id
+    0x00,                       // properties length
+    0x01,                       // granted qos 1
+    0x87,                       // not authorized
+    0b10110000,                 // UNSUBACK
+    0x04,                       // remaining length
+    0x00, 0x0B,                 // packet id
+    0x00,                       // properties length
+    0x00                        // success
+  };
+  Parser parser5;
+  parser5.setProtocolVersion(5);
+
+  size_t bytesRead = 0;
+  ParserResult result = parser5.parse(stream, 7, &bytesRead);
+
+  TEST_ASSERT_EQUAL_INT32(ParserResult::packet, result);
+  TEST_ASSERT_EQUAL_UINT32(7, bytesRead);
+  TEST_ASSERT_EQUAL_UINT16(10, parser5.getPacket().variableHeader.fixed.packetId);
+  TEST_ASSERT_EQUAL_UINT32(2, parser5.getPacket().payload.total);
+  TEST_ASSERT_EQUAL_UINT8(0x01, parser5.getPacket().payload.data[0]);
+  TEST_ASSERT_EQUAL_UINT8(0x80, parser5.getPacket().payload.data[1]);
+
+  bytesRead = 0;
+  result = parser5.parse(&stream[7], 6, &bytesRead);
+
+  TEST_ASSERT_EQUAL_INT32(ParserResult::packet, result);
+  TEST_ASSERT_EQUAL_UINT32(6, bytesRead);
+  TEST_ASSERT_EQUAL_UINT8(espMqttClientInternals::PacketType.UNSUBACK, parser5.getPacket().fixedHeader.packetType & 0xF0);
+  TEST_ASSERT_EQUAL_UINT16(11, parser5.getPacket().variableHeader.fixed.packetId);
+}
+
 int main() {
   UNITY_BEGIN();
   RUN_TEST(test_Connack);
@@ -351,5 +437,8 @@ int main() {
   RUN_TEST(test_UnsubAck);
   RUN_TEST(test_PingResp);
   RUN_TEST(test_longStream);
+  RUN_TEST(test_Connack5);
+  RUN_TEST(test_Publish5);
+  RUN_TEST(test_SubAck5);
   return UNITY_END();
 }
@@ -0,0 +1,137 @@
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+
+#include <Packets/Parser.h>
+
+using espMqttClientInternals::Parser;
+using espMqttClientInternals::ParserResult;
+using espMqttClientInternals::PacketType;
+
+void setUp() {}
+void tearDown() {}
+
+/*
+Typical traffic of a hub: commands on short topics, acks and a longer retained message
+- PUBLISH qos 1 "nuki/lock/action" "unlock"
+- PUBACK
+- PUBLISH qos 0 retain "nuki/presence/refresh" "0"
+- PUBLISH qos 1 "nuki/keypad/command/action" "add"
+- PUBLISH qos 0 "nuki/configuration/json" 120 bytes payload
+*/
+const size_t configPayloadLength = 120;
+uint8_t stream[256];
+size_t streamLength = 0;
+const size_t packetsInStream = 5;
+
+size_t addPublish(size_t pos, uint8_t header, const char* topic, uint16_t packetId, const uint8_t* payload, size_t payloadLength) {
+  size_t topicLength = strlen(topic);
+  size_t remainingLength = 2 + topicLength + (packetId ? 2 : 0) + payloadLength;
+  stream[pos++] = header;
+  pos += espMqttClientInternals::encodeRemainingLength(remainingLength, &stream[pos]);
+  stream[pos++] = topicLength >> 8;
+  stream[pos++] = topicLength & 0xFF;
+  memcpy(&stream[pos], topic, topicLength);
+  pos += topicLength;
+  if (packetId) {
+    stream[pos++] = packetId >> 8;
+    stream[pos++] = packetId & 0xFF;
+  }
+  memcpy(&stream[pos], payload, payloadLength);
+  return pos + payloadLength;
+}
+
+void buildStream() {
+  uint8_t config[configPayloadLength];
+  memset(config, 'x', configPayloadLength);
+  size_t pos = 0;
+  pos = addPublish(pos, 0x32, "nuki/lock/action", 1, reinterpret_cast<const uint8_t*>("unlock"), 6);
+  const uint8_t puback[] = {0x40, 0x02, 0x00, 0x02};
+  memcpy(&stream[pos], puback, sizeof(puback));
+  pos += sizeof(puback);
+  pos = addPublish(pos, 0x31, "nuki/presence/refresh", 0, reinterpret_cast<const uint8_t*>("0"), 1);
+  pos = addPublish(pos, 0x32, "nuki/keypad/command/action", 3, reinterpret_cast<const uint8_t*>("add"), 3);
+  pos = addPublish(pos, 0x30, "nuki/configuration/json", 0, config, configPayloadLength);
+  streamLength = pos;
+}
+
+// feeds the stream in pieces of chunkSize bytes and returns the number of complete packets
+size_t parseStream(Parser* parser, size_t chunkSize) {
+  size_t packets = 0;
+  size_t offset = 0;
+  while (offset < streamLength) {
+    size_t chunkLength = std::min(chunkSize, streamLength - offset);
+    size_t index = 0;
+    while (index < chunkLength) {
+      size_t bytesRead = 0;
+      ParserResult result = parser->parse(&stream[offset + index], chunkLength - index, &bytesRead);
+      index += bytesRead;
+      if (result == ParserResult::packet) {
+        const espMqttClientInternals::IncomingPacket& packet = parser->getPacket();
+        if ((packet.fixedHeader.packetType & 0xF0) != PacketType.PUBLISH ||
+            packet.payload.index + packet.payload.length == packet.payload.total) {
+          ++packets;
+        }
+      } else if (result == ParserResult::protocolError) {
+        return 0;
+      }
+    }
+    offset += chunkLength;
+  }
+  return packets;
+}
+
+void benchmark(size_t chunkSize, const char* name) {
+  const size_t iterations = 2000;
+  Parser parser;
+  size_t packets = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    packets += parseStream(&parser, chunkSize);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  TEST_ASSERT_EQUAL_UINT32(iterations * packetsInStream, packets);
+  double seconds = std::chrono::duration<double>(end - start).count();
+  char message[120];
+  snprintf(message, sizeof(message), "%s: %.0f packets/s, %.2f MB/s",
+           name,
+           packets / seconds,
+           iterations * streamLength / seconds / 1000000.0);
+  TEST_MESSAGE(message);
+}
+
+void test_completePackets() {
+  // every packet is entirely in the buffer: the fast path is used for PUBLISH
+  benchmark(sizeof(stream), "complete packets");
+}
+
+void test_splitPackets() {
+  // packets are split over reads: parsed byte by byte
+  benchmark(7, "split packets");
+}
+
+void test_completePublish() {
+  Parser parser;
+  size_t bytesRead = 0;
+  ParserResult result = parser.parse(stream, streamLength, &bytesRead);
+
+  TEST_ASSERT_EQUAL_INT32(ParserResult::packet, result);
+  TEST_ASSERT_EQUAL_STRING("nuki/lock/action", parser.getPacket().variableHeader.topic);
+  TEST_ASSERT_EQUAL_UINT16(1, parser.getPacket().variableHeader.fixed.packetId);
+  TEST_ASSERT_EQUAL_UINT32(6, parser.getPacket().payload.length);
+  TEST_ASSERT_EQUAL_UINT32(6, parser.getPacket().payload.total);
+  // payload is not copied
+  TEST_ASSERT_TRUE(parser.getPacket().payload.data == &stream[bytesRead - 6]);
+}
+
+int main() {
+  buildStream();
+  UNITY_BEGIN();
+  RUN_TEST(test_completePublish);
+  RUN_TEST(test_completePackets);
+  RUN_TEST(test_splitPackets);
+  return UNITY_END();
+}
@@ -6,44 +6,48 @@
 #include "PinMode.h"
 #include "InterruptMode.h"
 
-#define GPIO2GO_NR_OF_PINS 31
+#define GPIO2GO_NR_OF_PINS 32
 #define GPIO2GO_NR_FIRST_PIN 2
+#define GPIO2GO_MAX_SUBSCRIPTIONS 4
+
+// The only list of usable pins, the application offers exactly these pins for configuration
+constexpr uint8_t Gpio2GoSupportedPins[] = { 2, 4, 5, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 32, 33 };
+
+constexpr uint64_t gpio2GoPinMask(size_t index = 0)
+{
+    return index >= sizeof(Gpio2GoSupportedPins) ? 0 : (1ULL << Gpio2GoSupportedPins[index]) | gpio2GoPinMask(index + 1);
+}
+
+constexpr uint64_t Gpio2GoSupportedPinMask = gpio2GoPinMask();
+
+static_assert((Gpio2GoSupportedPinMask >> (GPIO2GO_NR_OF_PINS + GPIO2GO_NR_FIRST_PIN)) == 0 &&
+              (Gpio2GoSupportedPinMask & ((1ULL << GPIO2GO_NR_FIRST_PIN) - 1)) == 0,
+              "Supported pins have to be within the range handled by Gpio2Go");
+
+typedef void (*Gpio2GoCallback)(const int& pin);
 
 class Gpio2Go
 {
 public:
     static void configurePin(int pin, PinMode pin_Mode, InterruptMode interrupt_Mode, uint16_t timeoutAfterTriggerMS);
-    static void subscribe(std::function<void(const int&)> callback);
+    static void subscribe(Gpio2GoCallback callback);
 
-    unsigned long getLastTriggeredMillis(const int& pin);
+    static unsigned long getLastTriggeredMillis(const int& pin);
+    static unsigned long getLastEdgeMillis(const int& pin);
+    static void getEdgeStatistics(const int& pin, uint32_t& edgesSeen, uint32_t& edgesSuppressed);
 
 private:
+    static bool isValidPin(const int& pin);
     static void attachIsr(int pin, InterruptMode interruptMode);
     static int resolveInterruptMode(InterruptMode interruptMode);
 
-    static void IRAM_ATTR isrHandler(int pin);
-    static void IRAM_ATTR isrGpio2();
-    static void IRAM_ATTR isrGpio4();
-    static void IRAM_ATTR isrGpio5();
-    static void IRAM_ATTR isrGpio13();
-    static void IRAM_ATTR isrGpio14();
-    static void IRAM_ATTR isrGpio15();
-    static void IRAM_ATTR isrGpio16();
-    static void IRAM_ATTR isrGpio17();
-    static void IRAM_ATTR isrGpio18();
-    static void IRAM_ATTR isrGpio19();
-    static void IRAM_ATTR isrGpio20();
-    static void IRAM_ATTR isrGpio21();
-    static void IRAM_ATTR isrGpio22();
-    static void IRAM_ATTR isrGpio23();
-    static void IRAM_ATTR isrGpio24();
-    static void IRAM_ATTR isrGpio25();
-    static void IRAM_ATTR isrGpio26();
-    static void IRAM_ATTR isrGpio27();
-    static void IRAM_ATTR isrGpio32();
-    static void IRAM_ATTR isrGpio33();
+    static void IRAM_ATTR isrHandler(void* arg);
 
     static unsigned long DRAM_ATTR lastTriggeredTimestamps[GPIO2GO_NR_OF_PINS];
+    static unsigned long DRAM_ATTR lastEdgeTimestamps[GPIO2GO_NR_OF_PINS];
     static uint16_t DRAM_ATTR timeoutDurations[GPIO2GO_NR_OF_PINS];
-    static std::vector<std::function<void(const int&)>> DRAM_ATTR subscriptions;
+    static uint32_t DRAM_ATTR edgesSeen[GPIO2GO_NR_OF_PINS];
+    static uint32_t DRAM_ATTR edgesSuppressed[GPIO2GO_NR_OF_PINS];
+    static Gpio2GoCallback DRAM_ATTR subscriptions[GPIO2GO_MAX_SUBSCRIPTIONS];
+    static uint8_t DRAM_ATTR subscriptionCount;
 };
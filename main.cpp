@@ -14,6 +14,8 @@
 #include "RestartReason.h"
 #include "CharBuffer.h"
 #include "NukiDeviceId.h"
+#include "EventLog.h"
+#include "LoopTiming.h"
 
 Network* network = nullptr;
 NetworkLock* networkLock = nullptr;
@@ -31,6 +33,7 @@ Gpio* gpio = nullptr;
 
 bool lockEnabled = false;
 bool openerEnabled = false;
+bool webCfgInNetworkTask = false;
 unsigned long restartTs = (2^32) - 5 * 60000;
 
 RTC_NOINIT_ATTR int restartReason;
@@ -42,17 +45,29 @@ RestartReason currentRestartReason = RestartReason::NotApplicable;
 TaskHandle_t networkTaskHandle = nullptr;
 TaskHandle_t nukiTaskHandle = nullptr;
 TaskHandle_t presenceDetectionTaskHandle = nullptr;
+TaskHandle_t logTaskHandle = nullptr;
+TaskHandle_t webCfgTaskHandle = nullptr;
 
 void networkTask(void *pvParameters)
 {
     while(true)
     {
-        bool connected = network->update();
+        loopTiming(TimingId::NetworkLoop).mark();
+
+        bool connected = false;
+        {
+            ScopedTiming timing(TimingId::NetworkUpdate);
+            connected = network->update();
+        }
         if(connected && openerEnabled)
         {
             networkOpener->update();
         }
-        webCfgServer->update();
+        if(webCfgInNetworkTask)
+        {
+            ScopedTiming timing(TimingId::WebCfgUpdate);
+            webCfgServer->update();
+        }
 
         // millis() is about to overflow. Restart device to prevent problems with overflow
         if(millis() > restartTs)
@@ -63,13 +78,6 @@ void networkTask(void *pvParameters)
         }
 
         delay(100);
-
-//        if(wmts < millis())
-//        {
-//            Serial.print("# ");
-//            Serial.println(uxTaskGetStackHighWaterMark(NULL));
-//            wmts = millis() + 60000;
-//        }
     }
 }
 
@@ -77,7 +85,12 @@ void nukiTask(void *pvParameters)
 {
     while(true)
     {
-        bleScanner->update();
+        loopTiming(TimingId::NukiLoop).mark();
+
+        {
+            ScopedTiming timing(TimingId::BleScannerUpdate);
+            bleScanner->update();
+        }
         delay(20);
 
         bool needsPairing = (lockEnabled && !nuki->isPaired()) || (openerEnabled && !nukiOpener->isPaired());
@@ -89,32 +102,72 @@ void nukiTask(void *pvParameters)
 
         if(lockEnabled)
         {
+            ScopedTiming timing(TimingId::LockUpdate);
             nuki->update();
         }
         if(openerEnabled)
         {
+            ScopedTiming timing(TimingId::OpenerUpdate);
             nukiOpener->update();
         }
 
     }
 }
 
+// HTTP requests are handled in a separate task so that a slow or stalled client
+// can't delay MQTT processing in the network task. Not used with the W5500, see setupTasks().
+void webCfgTask(void *pvParameters)
+{
+    while(true)
+    {
+        {
+            ScopedTiming timing(TimingId::WebCfgUpdate);
+            webCfgServer->update();
+        }
+        delay(10);
+    }
+}
+
 void presenceDetectionTask(void *pvParameters)
 {
     while(true)
     {
+        loopTiming(TimingId::PresenceLoop).mark();
         presenceDetection->update();
     }
 }
 
 
+void logTask(void *pvParameters)
+{
+    while(true)
+    {
+        AsyncLog->drain();
+        eventLog->update();
+        delay(ASYNC_LOGGER_DRAIN_INTERVAL);
+    }
+}
+
 void setupTasks()
 {
     // configMAX_PRIORITIES is 25
 
+    // The Ethernet library driving the W5500 has no locking, the web server and the MQTT client share the chip.
+    // Their sockets are only used from the network task then. With WiFi and LAN8720 the sockets go through lwIP.
+    webCfgInNetworkTask = network->networkDeviceType() == NetworkDeviceType::W5500;
+
+    // Until the log task runs, setup logs straight to Serial
+    xTaskCreatePinnedToCore(logTask, "log", 3072, NULL, 1, &logTaskHandle, 1);
+    Log = AsyncLog;
+
     xTaskCreatePinnedToCore(networkTask, "ntw", 8192, NULL, 3, &networkTaskHandle, 1);
     xTaskCreatePinnedToCore(nukiTask, "nuki", 3328, NULL, 2, &nukiTaskHandle, 1);
-    xTaskCreatePinnedToCore(presenceDetectionTask, "prdet", 896, NULL, 5, &presenceDetectionTaskHandle, 1);
+    xTaskCreatePinnedToCore(presenceDetectionTask, "prdet", 2048, NULL, 5, &presenceDetectionTaskHandle, 1);
+
+    if(!webCfgInNetworkTask)
+    {
+        xTaskCreatePinnedToCore(webCfgTask, "web", 6144, NULL, 1, &webCfgTaskHandle, 1);
+    }
 }
 
 void initEthServer(const NetworkDeviceType device)
@@ -170,6 +223,7 @@ void setup()
 {
     Serial.begin(115200);
     Log = &Serial;
+    AsyncLog = new AsyncLogger();
 
     Log->print(F("Nuki Hub version ")); Log->println(NUKI_HUB_VERSION);
 
@@ -177,6 +231,9 @@ void setup()
 
     initializeRestartReason();
 
+    eventLog = new EventLog();
+    eventLog->initialize();
+    eventLog->record(EventId::Boot, (uint32_t)currentRestartReason | ((uint32_t)esp_reset_reason() << 16));
 
     uint32_t devIdOpener = preferences->getUInt(preference_device_id_opener);
 
@@ -221,6 +278,7 @@ void setup()
     bleScanner = new BleScanner::Scanner();
     bleScanner->initialize("NukiHub");
     bleScanner->setScanDuration(10);
+    bleScanner->setLowDutyCycle(BLE_SCAN_LOW_DUTY_INTERVAL, BLE_SCAN_LOW_DUTY_WINDOW);
 
     Log->println(lockEnabled ? F("Nuki Lock enabled") : F("Nuki Lock disabled"));
     if(lockEnabled)
@@ -238,8 +296,12 @@ void setup()
 
     webCfgServer = new WebCfgServer(nuki, nukiOpener, network, gpio, ethServer, preferences, network->networkDeviceType() == NetworkDeviceType::WiFi);
     webCfgServer->initialize();
+    networkLock->setOtaUpdateReceivedCallback([]()
+    {
+        webCfgServer->startHttpOta();
+    });
 
-    presenceDetection = new PresenceDetection(preferences, bleScanner, network, CharBuffer::get(), CHAR_BUFFER_SIZE);
+    presenceDetection = new PresenceDetection(preferences, bleScanner, network);
     presenceDetection->initialize();
 
     setupTasks();
@@ -40,6 +40,35 @@ void NetworkDevice::mqttSetCleanSession(bool cleanSession)
     }
 }
 
+void NetworkDevice::mqttSetProtocolVersion(uint8_t protocolVersion)
+{
+    if (_useEncryption)
+    {
+        _mqttClientSecure->setProtocolVersion(protocolVersion);
+    }
+    else
+    {
+        _mqttClient->setProtocolVersion(protocolVersion);
+    }
+}
+
+void NetworkDevice::mqttSetSessionExpiryInterval(uint32_t sessionExpiryInterval)
+{
+    if (_useEncryption)
+    {
+        _mqttClientSecure->setSessionExpiryInterval(sessionExpiryInterval);
+    }
+    else
+    {
+        _mqttClient->setSessionExpiryInterval(sessionExpiryInterval);
+    }
+}
+
+bool NetworkDevice::mqttAddTopicAlias(const char *topic)
+{
+    return getMqttClient()->addTopicAlias(topic);
+}
+
 uint16_t NetworkDevice::mqttPublish(const char *topic, uint8_t qos, bool retain, const char *payload)
 {
     return getMqttClient()->publish(topic, qos, retain, payload);
@@ -50,6 +79,11 @@ uint16_t NetworkDevice::mqttPublish(const char *topic, uint8_t qos, bool retain,
     return getMqttClient()->publish(topic, qos, retain, payload, length);
 }
 
+uint16_t NetworkDevice::mqttPublish(const char *topic, uint8_t qos, bool retain, const char *payload, uint32_t messageExpiryInterval)
+{
+    return getMqttClient()->publish(topic, qos, retain, reinterpret_cast<const uint8_t*>(payload), strlen(payload), messageExpiryInterval);
+}
+
 bool NetworkDevice::mqttConnected() const
 {
     return getMqttClient()->connected();
@@ -142,6 +176,11 @@ uint16_t NetworkDevice::mqttSubscribe(const char *topic, uint8_t qos)
     return getMqttClient()->subscribe(topic, qos);
 }
 
+uint16_t NetworkDevice::mqttSubscribe(const espMqttClientTypes::SubscribeItem* list, size_t numberTopics)
+{
+    return getMqttClient()->subscribe(list, numberTopics);
+}
+
 void NetworkDevice::disableMqtt()
 {
     getMqttClient()->disconnect();
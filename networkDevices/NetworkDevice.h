@@ -36,8 +36,12 @@ public:
 
     virtual void mqttSetClientId(const char* clientId);
     virtual void mqttSetCleanSession(bool cleanSession);
+    virtual void mqttSetProtocolVersion(uint8_t protocolVersion);
+    virtual void mqttSetSessionExpiryInterval(uint32_t sessionExpiryInterval);
+    virtual bool mqttAddTopicAlias(const char* topic);
     virtual uint16_t mqttPublish(const char* topic, uint8_t qos, bool retain, const char* payload);
     virtual uint16_t mqttPublish(const char* topic, uint8_t qos, bool retain, const uint8_t* payload, size_t length);
+    virtual uint16_t mqttPublish(const char* topic, uint8_t qos, bool retain, const char* payload, uint32_t messageExpiryInterval);
     virtual bool mqttConnected() const;
     virtual void mqttSetServer(const char* host, uint16_t port);
     virtual bool mqttConnect();
@@ -50,6 +54,7 @@ public:
     virtual void disableMqtt();
 
     virtual uint16_t mqttSubscribe(const char* topic, uint8_t qos);
+    virtual uint16_t mqttSubscribe(const espMqttClientTypes::SubscribeItem* list, size_t numberTopics);
 
 protected:
     espMqttClient *_mqttClient = nullptr;
@@ -63,7 +63,7 @@ void W5500Device::initialize()
         _path = new char[pathStr.length() + 1];
         memset(_path, 0, sizeof(_path));
         strcpy(_path, pathStr.c_str());
-        Log = new MqttLogger(*getMqttClient(), _path, MqttLoggerMode::MqttAndSerial);
+        AsyncLog->setMqttClient(getMqttClient(), _path);
     }
 
     reconnect();